@@ -0,0 +1,468 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file benchmark_main.c
+ * @brief Micro-benchmark of the hot paths of the thermistor driver.
+ *
+ * Each case is measured with esp_cpu_get_cycle_count() and esp_timer_get_time(),
+ * and printed as a CSV line, so the output of several builds (ADC mode, math 
+ * precision, lookup table) can be compared with a script:
+ *
+ *     bench,<case>,<samples>,<iterations>,<cycles per op>,<ns per op>
+ *
+ * The first lines describe the configuration of the build. The jitter lines 
+ * describe the timer driven sampling, and the last checks count the heap 
+ * allocations after the init of the direct readings and of the driver tasks:
+ *
+ *     heap,<case>,<allocations>,<free bytes before>,<free bytes after>,<pass|fail>
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_cpu.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+#include "thermistor.h"
+#include "thermistor_filter.h"
+#include "thermistor_telemetry.h"
+
+#include "sdkconfig.h"
+
+#define ITERATIONS      CONFIG_BENCHMARK_ITERATIONS
+#define CALC_ITERATIONS (CONFIG_BENCHMARK_ITERATIONS * 100)  // Conversions without ADC access.
+
+static volatile uint32_t s_sink;    // Keeps the results, so the compiler doesn't remove the calls.
+
+static const uint32_t s_samples[] = {1, 4, 16, 64, 256, 1024};
+
+static volatile uint32_t s_heap_allocs;  // Allocations of the heap since boot.
+
+#if CONFIG_HEAP_USE_HOOKS
+void IRAM_ATTR esp_heap_trace_alloc_hook(void* ptr, size_t size, uint32_t caps)
+{
+    s_heap_allocs++;
+}
+
+void IRAM_ATTR esp_heap_trace_free_hook(void* ptr)
+{
+}
+#endif
+
+/**
+ * @brief Measure a statement, and print the mean per iteration.
+ */
+#define BENCH(name, samples, iterations, statement)                             \
+    do {                                                                        \
+        int64_t start_us = esp_timer_get_time();                                \
+        uint32_t start_cycles = esp_cpu_get_cycle_count();                      \
+        for (uint32_t _i = 0; _i < (iterations); _i++) {                        \
+            statement;                                                          \
+        }                                                                       \
+        uint32_t cycles = esp_cpu_get_cycle_count() - start_cycles;             \
+        int64_t elapsed_us = esp_timer_get_time() - start_us;                   \
+        printf("bench,%s,%u,%u,%u,%lld\n", (name), (unsigned)(samples),         \
+               (unsigned)(iterations), (unsigned)(cycles / (iterations)),       \
+               (long long)((elapsed_us * 1000) / (iterations)));                \
+    } while (0)
+
+static void print_config(void)
+{
+    printf("config,target,%s\n", CONFIG_IDF_TARGET);
+    printf("config,cpu_mhz,%d\n", CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+#if CONFIG_THERMISTOR_ADC_MODE_CONTINUOUS
+    printf("config,adc_mode,continuous\n");
+#else
+    printf("config,adc_mode,oneshot\n");
+#endif
+#if CONFIG_THERMISTOR_MATH_FLOAT
+    printf("config,math,float\n");
+#else
+    printf("config,math,double\n");
+#endif
+#if CONFIG_THERMISTOR_LUT_ROM
+    printf("config,lut,rom\n");
+#elif CONFIG_THERMISTOR_LUT
+    printf("config,lut,ram\n");
+#else
+    printf("config,lut,none\n");
+#endif
+}
+
+static void bench_read(thermistor_handle_t* th)
+{
+    for (size_t i = 0; i < sizeof(s_samples) / sizeof(s_samples[0]); i++) {
+        uint32_t samples = s_samples[i];
+        uint8_t alarms;
+
+        thermistor_set_oversampling(th, samples);
+        BENCH("read_vout", samples, ITERATIONS, s_sink = thermistor_read_vout(th));
+        BENCH("get_celsius", samples, ITERATIONS, s_sink = thermistor_get_celsius(th));
+        BENCH("read_alarm", samples, ITERATIONS, thermistor_read_alarm(th, &alarms); s_sink = alarms);
+    }
+
+    thermistor_set_oversampling(th, 64);
+}
+
+static void bench_convert(thermistor_handle_t* th)
+{
+    uint32_t vout = 1000;
+
+    // The same vout each time would measure only the branch predictor of the C3.
+#define NEXT_VOUT()     (vout = (vout + 37) & 2047)
+
+#if CONFIG_THERMISTOR_LUT
+    BENCH("vout_to_celsius_lut", 0, CALC_ITERATIONS, s_sink = thermistor_vout_to_celsius(th, NEXT_VOUT()));
+    BENCH("vout_to_centi_lut", 0, CALC_ITERATIONS, s_sink = thermistor_vout_to_centi_celsius(th, NEXT_VOUT()));
+
+    // Without the table the same handle uses the equation.
+    const thermistor_lut_t* lut = th->lut;
+    th->lut = NULL;
+#endif
+
+    BENCH("vout_to_celsius", 0, CALC_ITERATIONS, s_sink = thermistor_vout_to_celsius(th, NEXT_VOUT()));
+    BENCH("vout_to_centi", 0, CALC_ITERATIONS, s_sink = thermistor_vout_to_centi_celsius(th, NEXT_VOUT()));
+    BENCH("raw_to_celsius", 0, CALC_ITERATIONS, s_sink = thermistor_raw_to_celsius(th, NEXT_VOUT()));
+
+#if CONFIG_THERMISTOR_LUT
+    th->lut = lut;
+#endif
+
+    BENCH("alarm_update", 0, CALC_ITERATIONS, s_sink = thermistor_alarm_update(&th->alarm, NEXT_VOUT()));
+}
+
+static void bench_filters(void)
+{
+    static const struct {
+        const char* name;
+        thermistor_filter_config_t config;
+    } filters[] = {
+        { "filter_none", { .type = THERMISTOR_FILTER_NONE } },
+        { "filter_ema", { .type = THERMISTOR_FILTER_EMA, .ema_shift = 4 } },
+        { "filter_median", { .type = THERMISTOR_FILTER_MEDIAN, .median_window = 9 } },
+        { "filter_cic", { .type = THERMISTOR_FILTER_CIC, .cic_order = 3, .cic_decimation_shift = 4 } },
+    };
+    thermistor_filter_t filter;
+    uint16_t raw = 1000;
+
+    for (size_t i = 0; i < sizeof(filters) / sizeof(filters[0]); i++) {
+        thermistor_filter_init(&filter, &filters[i].config);
+        BENCH(filters[i].name, 0, CALC_ITERATIONS, 
+              s_sink = thermistor_filter_update(&filter, raw = (raw + 37) & 4095));
+    }
+}
+
+static void bench_telemetry(void)
+{
+    thermistor_telemetry_encoder_t enc;
+    uint8_t record[THERMISTOR_TELEMETRY_MAX_RECORD];
+    int16_t centi = 2500;
+
+    thermistor_telemetry_encoder_init(&enc, 50);
+    BENCH("telemetry_encode", 0, CALC_ITERATIONS, 
+          s_sink = thermistor_telemetry_encode(&enc, 1000, centi += 3, record, sizeof(record)));
+}
+
+/**
+ * @brief Perform an asynchronous reading and wait for its end.
+ *
+ * The worker ends the reading just after notifying it, so on the other core 
+ * the handle can still be busy for a moment after the notification.
+ */
+static void read_async_wait(thermistor_handle_t* th, const thermistor_async_t* done)
+{
+    thermistor_read_async(th, done);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    while (th->async_pending) {
+        taskYIELD();
+    }
+}
+
+static void bench_async(thermistor_handle_t* th)
+{
+    thermistor_async_t done = {
+        .notify_task = xTaskGetCurrentTaskHandle(),
+    };
+
+    // Latency from the request to the notification of the reading.
+    for (size_t i = 0; i < sizeof(s_samples) / sizeof(s_samples[0]); i++) {
+        thermistor_set_oversampling(th, s_samples[i]);
+        BENCH("read_async", s_samples[i], ITERATIONS, read_async_wait(th, &done));
+    }
+
+    thermistor_set_oversampling(th, 64);
+}
+
+/**
+ * @brief Measure the spacing of the timestamps of the timer driven readings:
+ *
+ *     jitter,<period us>,<readings>,<min interval us>,<max interval us>,<missed>
+ */
+static void bench_sampling(thermistor_handle_t* th)
+{
+    static const uint32_t periods_us[] = {100000, 10000, 2000};
+    static thermistor_ring_t ring;
+    static thermistor_sample_t samples[THERMISTOR_RING_SIZE];
+
+    thermistor_set_oversampling(th, 16);
+
+    for (size_t i = 0; i < sizeof(periods_us) / sizeof(periods_us[0]); i++) {
+        uint32_t count = (THERMISTOR_RING_SIZE < 64) ? THERMISTOR_RING_SIZE : 64;
+
+        thermistor_set_ring(th, &ring);
+        thermistor_start_sampling_us(th, periods_us[i]);
+        vTaskDelay(pdMS_TO_TICKS((uint64_t)periods_us[i] * count / 1000) + 2);
+        thermistor_stop_sampling(th);
+        thermistor_set_ring(th, NULL);
+
+        size_t n = thermistor_drain(&ring, samples, count);
+        int64_t min_us = INT64_MAX;
+        int64_t max_us = 0;
+
+        for (size_t j = 1; j < n; j++) {
+            int64_t interval_us = samples[j].timestamp_us - samples[j - 1].timestamp_us;
+
+            min_us = (interval_us < min_us) ? interval_us : min_us;
+            max_us = (interval_us > max_us) ? interval_us : max_us;
+        }
+
+        printf("jitter,%u,%u,%lld,%lld,%u\n", (unsigned)periods_us[i], (unsigned)n, 
+               (long long)((n > 1) ? min_us : 0), (long long)max_us, (unsigned)th->sampling_missed);
+    }
+
+    thermistor_set_oversampling(th, 64);
+}
+
+/**
+ * @brief Allocations and free memory of the heap at the start of a check.
+ */
+typedef struct {
+    uint32_t allocs;
+    size_t free_before;
+} heap_check_t;
+
+static void heap_check_begin(heap_check_t* check)
+{
+    check->free_before = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+    check->allocs = s_heap_allocs;
+}
+
+static void heap_check_end(const heap_check_t* check, const char* name)
+{
+    uint32_t allocs = s_heap_allocs - check->allocs;
+    size_t free_after = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+
+    // Without the hooks only the leaks are detected.
+    printf("heap,%s,%u,%u,%u,%s\n", name, (unsigned)allocs, (unsigned)check->free_before, 
+           (unsigned)free_after, ((allocs == 0) && (free_after == check->free_before)) ? "pass" : "fail");
+}
+
+/**
+ * @brief Check the sampling task, with its start and stop in static mode.
+ */
+static void check_sampling(thermistor_handle_t* th)
+{
+    heap_check_t check;
+
+#if CONFIG_THERMISTOR_STATIC_ALLOCATION
+    heap_check_begin(&check);
+    for (uint32_t i = 0; i < 4; i++) {
+        thermistor_start_sampling_us(th, 1000);
+        vTaskDelay(pdMS_TO_TICKS(50));
+        thermistor_stop_sampling(th);
+    }
+    heap_check_end(&check, "sampling");
+#else
+    // In the heap the start creates the task, only its readings are checked.
+    thermistor_start_sampling_us(th, 1000);
+    heap_check_begin(&check);
+    vTaskDelay(pdMS_TO_TICKS(200));
+    heap_check_end(&check, "sampling");
+    thermistor_stop_sampling(th);
+#endif
+}
+
+#if CONFIG_THERMISTOR_PIPELINE
+/**
+ * @brief Check the pipeline, with its start and stop in static mode.
+ */
+static void check_pipeline(thermistor_handle_t* th)
+{
+    thermistor_pipeline_config_t config = {
+        .period_us = 1000,
+        .batch = 8,
+        .acquisition_core = 0,
+        .processing_core = 1,
+    };
+    heap_check_t check;
+
+#if CONFIG_THERMISTOR_STATIC_ALLOCATION
+    heap_check_begin(&check);
+    for (uint32_t i = 0; i < 4; i++) {
+        thermistor_start_pipeline(th, &config);
+        vTaskDelay(pdMS_TO_TICKS(50));
+        thermistor_stop_pipeline(th);
+    }
+    heap_check_end(&check, "pipeline");
+#else
+    thermistor_start_pipeline(th, &config);
+    heap_check_begin(&check);
+    vTaskDelay(pdMS_TO_TICKS(200));
+    heap_check_end(&check, "pipeline");
+    thermistor_stop_pipeline(th);
+#endif
+}
+#endif
+
+/**
+ * @brief Check that the readings and conversions don't use the heap after the init.
+ */
+static void check_heap(thermistor_handle_t* th)
+{
+    thermistor_async_t done = {
+        .notify_task = xTaskGetCurrentTaskHandle(),
+    };
+    heap_check_t check;
+    uint8_t alarms;
+
+    // The first asynchronous reading creates the worker (statically with 
+    // CONFIG_THERMISTOR_STATIC_ALLOCATION), and the first start of the 
+    // sampling creates the timer of the handle, they are part of the init.
+    read_async_wait(th, &done);
+    thermistor_start_sampling_us(th, 1000);
+    thermistor_stop_sampling(th);
+
+    heap_check_begin(&check);
+    for (uint32_t i = 0; i < ITERATIONS; i++) {
+        s_sink = thermistor_read_vout(th);
+        s_sink = thermistor_get_celsius(th);
+        thermistor_read_alarm(th, &alarms);
+        s_sink = thermistor_raw_to_conversion(th, i & 4095).celsius;
+        read_async_wait(th, &done);
+    }
+    heap_check_end(&check, "readings");
+
+    // The changes of the parameters rebuild the spare table reserved by the init.
+    thermistor_beta_t beta = {
+        .nominal_resistance = th->nominal_resistance,
+        .nominal_temperature = th->nominal_temperature,
+        .beta_val = th->beta_val,
+    };
+    float serial_resistance = th->serial_resistance;
+    float vsource = th->vsource;
+
+    heap_check_begin(&check);
+    for (uint32_t i = 0; i < 16; i++) {
+        thermistor_set_divider(th, serial_resistance * ((i & 1) ? 1.1f : 1.0f), vsource);
+        s_sink = thermistor_get_celsius(th);
+        thermistor_set_beta(th, &beta);
+        thermistor_apply_params(th);
+    }
+    thermistor_set_divider(th, serial_resistance, vsource);
+    thermistor_apply_params(th);
+    heap_check_end(&check, "params");
+
+    check_sampling(th);
+
+#if CONFIG_THERMISTOR_PIPELINE
+    check_pipeline(th);
+#endif
+
+#if CONFIG_THERMISTOR_STATIC_ALLOCATION
+    size_t used;
+    size_t peak;
+
+    thermistor_get_arena_usage(&used, &peak);
+    printf("arena,%u,%u,%u\n", (unsigned)used, (unsigned)peak, CONFIG_THERMISTOR_ARENA_SIZE);
+#endif
+}
+
+#if CONFIG_THERMISTOR_STATS
+static void print_histogram(const char* name, const thermistor_histogram_t* hist)
+{
+    printf("stats,%s,%u,%u,%u", name, (unsigned)hist->count, 
+           (unsigned)((hist->count > 0) ? hist->min : 0), (unsigned)hist->max);
+    for (size_t i = 0; i < THERMISTOR_STATS_BINS; i++) {
+        printf(",%u", (unsigned)hist->bins[i]);
+    }
+    printf("\n");
+}
+
+/**
+ * @brief Print the counters of the driver for all the readings of the benchmark.
+ */
+static void print_stats(const thermistor_handle_t* th)
+{
+    thermistor_stats_t stats;
+
+    thermistor_get_stats(th, &stats);
+    printf("stats,reads,%u,errors,%u,last_error,%d,cali_fallbacks,%u,nvs_misses,%u\n", (unsigned)stats.reads, 
+           (unsigned)stats.read_errors, (int)stats.last_error, (unsigned)stats.cali_fallbacks,
+           (unsigned)stats.nvs_misses);
+    print_histogram("burst_us", &stats.burst_us);
+    print_histogram("convert_cycles", &stats.convert_cycles);
+}
+#endif
+
+void app_main(void)
+{
+    thermistor_handle_t th = {0};
+
+    ESP_ERROR_CHECK(thermistor_init(&th, CONFIG_BENCHMARK_ADC_CHANNEL,
+                                    CONFIG_SERIE_RESISTANCE, 
+                                    CONFIG_NOMINAL_RESISTANCE, 
+                                    CONFIG_NOMINAL_TEMPERATURE,
+                                    CONFIG_BETA_VALUE, 
+                                    CONFIG_VOLTAGE_SOURCE));
+
+    thermistor_alarm_config_t alarm = {
+        .high_celsius = 60,
+        .low_celsius = 0,
+        .hysteresis = 2,
+    };
+    thermistor_set_alarm(&th, &alarm);
+
+    // Let the boot messages finish before measuring.
+    vTaskDelay(pdMS_TO_TICKS(500));
+
+    print_config();
+    bench_read(&th);
+    bench_convert(&th);
+    bench_filters();
+    bench_telemetry();
+    bench_async(&th);
+    bench_sampling(&th);
+    check_heap(&th);
+#if CONFIG_THERMISTOR_STATS
+    print_stats(&th);
+#endif
+    ESP_ERROR_CHECK(thermistor_deinit(&th));
+    printf("done\n");
+}
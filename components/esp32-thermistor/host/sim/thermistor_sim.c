@@ -0,0 +1,287 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_sim.c
+ * @brief Mock of the ESP-IDF calls of the driver for the host simulation.
+ */
+
+#include "thermistor_sim.h"
+#include "thermistor_continuous.h"
+#include "thermistor_model.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "esp_adc/adc_continuous.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+#include "freertos/semphr.h"
+
+#define FULL_CODE   4095
+
+struct adc_cali_scheme_t
+{
+    adc_atten_t atten;
+};
+
+/**
+ * @brief Input in mV that reads the full scale code with each attenuation.
+ */
+static const float s_full_scale_mv[ADC_ATTEN_DB_12 + 1] = { 750, 1050, 1300, 2500 };
+
+static thermistor_sim_config_t s_config;
+static thermistor_coeffs_t s_coeffs;
+static uint64_t s_conversions;
+static int64_t s_delay_us;
+static uint32_t s_rng;
+static const uint16_t* s_trace;
+static size_t s_trace_count;
+static adc_atten_t s_atten[ADC_CHANNEL_9 + 1];
+
+/**
+ * @brief Xorshift generator, uniform in (0, 1].
+ */
+static float rng_uniform(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+
+    return (s_rng + 1.0f) / 4294967296.0f;
+}
+
+/**
+ * @brief Normal sample with the Box-Muller transform.
+ */
+static float rng_gauss(void)
+{
+    return sqrtf(-2.0f * logf(rng_uniform())) * cosf(6.2831853f * rng_uniform());
+}
+
+esp_err_t thermistor_sim_init(const thermistor_sim_config_t* config)
+{
+    thermistor_model_config_t model = {
+        .model = THERMISTOR_MODEL_BETA,
+        .beta = {
+            .nominal_resistance = config->nominal_resistance,
+            .nominal_temperature = config->nominal_temperature,
+            .beta_val = config->beta_val,
+        },
+    };
+
+    if (!thermistor_model_prepare(&s_coeffs, &model) || !(config->serial_resistance > 0) ||
+        !(config->vsource > 0) || (config->sample_rate_hz == 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_config = *config;
+    s_conversions = 0;
+    s_delay_us = 0;
+    s_rng = (config->seed != 0) ? config->seed : 1;
+
+    return ESP_OK;
+}
+
+void thermistor_sim_set_trace(const uint16_t* codes, size_t count)
+{
+    s_trace = codes;
+    s_trace_count = count;
+}
+
+float thermistor_sim_celsius(int64_t time_us)
+{
+    if (s_config.amplitude == 0) {
+        return s_config.celsius;
+    }
+
+    return s_config.celsius + s_config.amplitude * sinf(6.2831853f * (float)(time_us * 1e-6 / s_config.period_s));
+}
+
+uint64_t thermistor_sim_conversions(void)
+{
+    return s_conversions;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return (int64_t)((s_conversions * 1000000) / s_config.sample_rate_hz) + s_delay_us;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    // The simulation has no sampling task, the handles never have a timer.
+    return ESP_OK;
+}
+
+void esp_rom_delay_us(uint32_t us)
+{
+    s_delay_us += us;
+}
+
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void)
+{
+    struct timespec ts;
+
+    // Nanoseconds of the host instead of cycles.
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (esp_cpu_cycle_count_t)((ts.tv_sec * 1000000000LL) + ts.tv_nsec);
+}
+
+const char* esp_err_to_name(esp_err_t code)
+{
+    static char name[16];
+
+    snprintf(name, sizeof(name), "0x%x", (unsigned)code);
+
+    return name;
+}
+
+esp_err_t adc_oneshot_new_unit(const adc_oneshot_unit_init_cfg_t* init_config, adc_oneshot_unit_handle_t* ret_unit)
+{
+    static int unit;
+
+    *ret_unit = (adc_oneshot_unit_handle_t)&unit;
+
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_config_channel(adc_oneshot_unit_handle_t handle, adc_channel_t channel, 
+                                     const adc_oneshot_chan_cfg_t* config)
+{
+    if ((channel > ADC_CHANNEL_9) || (config->atten > ADC_ATTEN_DB_12)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_atten[channel] = config->atten;
+
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_read(adc_oneshot_unit_handle_t handle, adc_channel_t chan, int* out_raw)
+{
+    int64_t time_us = esp_timer_get_time();
+    uint64_t index = s_conversions++;
+
+    if (s_trace_count > 0) {
+        *out_raw = s_trace[index % s_trace_count];
+        return ESP_OK;
+    }
+
+    // All the channels read the divider.
+    float resistance = thermistor_model_resistance(&s_coeffs, thermistor_sim_celsius(time_us));
+    float mv = (s_config.vsource * resistance) / (s_config.serial_resistance + resistance);
+    float code = roundf((mv + (s_config.noise_mv * rng_gauss())) * FULL_CODE / s_full_scale_mv[s_atten[chan]]);
+
+    *out_raw = (code <= 0) ? 0 : (code >= FULL_CODE) ? FULL_CODE : (int)code;
+
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_del_unit(adc_oneshot_unit_handle_t handle)
+{
+    return ESP_OK;
+}
+
+esp_err_t adc_cali_create_scheme_curve_fitting(const adc_cali_curve_fitting_config_t* config, 
+                                               adc_cali_handle_t* ret_handle)
+{
+    adc_cali_handle_t handle = malloc(sizeof(struct adc_cali_scheme_t));
+
+    if (handle == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    handle->atten = config->atten;
+    *ret_handle = handle;
+
+    return ESP_OK;
+}
+
+esp_err_t adc_cali_delete_scheme_curve_fitting(adc_cali_handle_t handle)
+{
+    free(handle);
+
+    return ESP_OK;
+}
+
+esp_err_t adc_cali_raw_to_voltage(adc_cali_handle_t handle, int raw, int* voltage)
+{
+    *voltage = (int)lroundf(raw * s_full_scale_mv[handle->atten] / FULL_CODE);
+
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_stop(adc_continuous_handle_t handle)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t adc_continuous_deinit(adc_continuous_handle_t handle)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t thermistor_continuous_start(adc_continuous_handle_t handle, const adc_channel_t* channels,
+                                      const adc_atten_t* attens, size_t count)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    return ESP_OK;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t* buffer)
+{
+    return (SemaphoreHandle_t)buffer;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    return pdTRUE;
+}
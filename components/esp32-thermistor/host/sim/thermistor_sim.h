@@ -0,0 +1,109 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_sim.h
+ * @brief Source of the conversions of the mock ADC of the host simulation.
+ *
+ * The mock implements the oneshot driver and the calibration calls of the 
+ * ESP-IDF, so the sources of the driver run unchanged on the host. Each 
+ * conversion of the thermistor channel advances the simulated time (returned 
+ * by esp_timer_get_time()) one period of the sample rate, and returns the 
+ * code of a synthetic divider or the next code of a recorded trace.
+ *
+ * The synthetic divider follows the beta model from a sinusoidal 
+ * temperature, with Gaussian noise in mV before the quantization, so the 
+ * readings can be compared with the exact temperature.
+ */
+
+#ifndef __THERMISTOR_SIM_H__
+#define __THERMISTOR_SIM_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+/**
+ * @brief Parameters of the simulated divider and of its temperature.
+ */
+typedef struct
+{
+    float serial_resistance;        /**< Serial resistor connected to vsource. */
+    float nominal_resistance;       /**< Resistance of the thermistor at the nominal temperature. */
+    float nominal_temperature;      /**< Nominal temperature in degrees Celsius. */
+    float beta_val;                 /**< Beta coefficient of the thermistor. */
+    float vsource;                  /**< Voltage of the source in mV. */
+    float celsius;                  /**< Mean temperature in degrees Celsius. */
+    float amplitude;                /**< Amplitude of the sinusoid in degrees Celsius, 0 for a constant temperature. */
+    float period_s;                 /**< Period of the sinusoid in seconds. */
+    float noise_mv;                 /**< Standard deviation of the noise in mV. */
+    uint32_t sample_rate_hz;        /**< Conversions per second of the simulated ADC. */
+    uint32_t seed;                  /**< Seed of the noise, the runs are repeatable. */
+} thermistor_sim_config_t;
+
+/**
+ * @brief Start a simulation with a synthetic divider, at time 0.
+ *
+ * @param   config Parameters of the simulation, they are copied.
+ *
+ * @return
+ *      - ESP_OK: The simulation is ready.
+ *      - ESP_ERR_INVALID_ARG: The divider or the sample rate are not valid.
+ */
+esp_err_t thermistor_sim_init(const thermistor_sim_config_t* config);
+
+/**
+ * @brief Replay raw codes instead of the synthetic divider, in a loop.
+ *
+ * @param   codes Codes of the 12 dB attenuation, for example logged by the device. 
+ *                The array must be valid during the simulation.
+ * @param   count Number of codes, 0 returns to the synthetic divider.
+ */
+void thermistor_sim_set_trace(const uint16_t* codes, size_t count);
+
+/**
+ * @brief Exact temperature of the synthetic divider.
+ *
+ * @param   time_us Simulated time in microseconds.
+ *
+ * @return
+ *      - Temperature in degrees Celsius.
+ */
+float thermistor_sim_celsius(int64_t time_us);
+
+/**
+ * @brief Number of conversions of the thermistor channel since the init.
+ */
+uint64_t thermistor_sim_conversions(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __THERMISTOR_SIM_H__ */
@@ -0,0 +1,143 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_convert_main.c
+ * @brief Host tool that converts logged raw codes to degrees Celsius.
+ *
+ * The codes are read from stdin, as text (one code per line) or as binary 
+ * uint16 little endian with --binary, and the temperatures are written to 
+ * stdout in the same format (float32 in binary mode). The parameters are the 
+ * ones of the thermistor and of thermistor_get_convert() on the device:
+ *
+ *     thermistor_convert --serial-resistance 164000 --nominal-resistance 100000 \
+ *                        --nominal-temperature 25 --beta 4250 --vsource 3330 \
+ *                        --mv-per-code 0.8 --offset-mv 0 < codes.txt
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "thermistor_convert.h"
+
+#define CHUNK   4096    // Codes converted by each batch.
+
+static void usage(const char* name)
+{
+    fprintf(stderr, "usage: %s [--binary] --serial-resistance R --vsource MV "
+                    "--mv-per-code G [--offset-mv O]\n"
+                    "       (--nominal-resistance R0 --nominal-temperature T0 --beta B | "
+                    "--steinhart-hart A B C)\n", name);
+}
+
+static size_t read_codes(FILE* in, bool binary, uint16_t* codes, size_t max)
+{
+    if (binary) {
+        return fread(codes, sizeof(uint16_t), max, in);
+    }
+
+    char line[32];
+    size_t n = 0;
+
+    while ((n < max) && (fgets(line, sizeof(line), in) != NULL)) {
+        char* end;
+        unsigned long code = strtoul(line, &end, 10);
+
+        if (end != line) {
+            codes[n++] = (code > UINT16_MAX) ? UINT16_MAX : (uint16_t)code;
+        }
+    }
+
+    return n;
+}
+
+int main(int argc, char** argv)
+{
+    thermistor_model_config_t model = {
+        .model = THERMISTOR_MODEL_BETA,
+    };
+    float serial_resistance = 0;
+    float vsource = 0;
+    float mv_per_code = 0;
+    float offset_mv = 0;
+    bool binary = false;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool has_value = (i + 1) < argc;
+
+        if (strcmp(arg, "--binary") == 0) {
+            binary = true;
+        } else if (has_value && (strcmp(arg, "--serial-resistance") == 0)) {
+            serial_resistance = strtof(argv[++i], NULL);
+        } else if (has_value && (strcmp(arg, "--vsource") == 0)) {
+            vsource = strtof(argv[++i], NULL);
+        } else if (has_value && (strcmp(arg, "--mv-per-code") == 0)) {
+            mv_per_code = strtof(argv[++i], NULL);
+        } else if (has_value && (strcmp(arg, "--offset-mv") == 0)) {
+            offset_mv = strtof(argv[++i], NULL);
+        } else if (has_value && (strcmp(arg, "--nominal-resistance") == 0)) {
+            model.beta.nominal_resistance = strtof(argv[++i], NULL);
+        } else if (has_value && (strcmp(arg, "--nominal-temperature") == 0)) {
+            model.beta.nominal_temperature = strtof(argv[++i], NULL);
+        } else if (has_value && (strcmp(arg, "--beta") == 0)) {
+            model.beta.beta_val = strtof(argv[++i], NULL);
+        } else if (((i + 3) < argc) && (strcmp(arg, "--steinhart-hart") == 0)) {
+            model.model = THERMISTOR_MODEL_STEINHART_HART;
+            model.steinhart_hart.a = strtof(argv[++i], NULL);
+            model.steinhart_hart.b = strtof(argv[++i], NULL);
+            model.steinhart_hart.c = strtof(argv[++i], NULL);
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    thermistor_convert_t conv;
+
+    if (!thermistor_convert_init(&conv, serial_resistance, vsource, &model, mv_per_code, offset_mv)) {
+        fprintf(stderr, "invalid parameters\n");
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    static uint16_t codes[CHUNK];
+    static float celsius[CHUNK];
+    size_t n;
+
+    while ((n = read_codes(stdin, binary, codes, CHUNK)) > 0) {
+        thermistor_convert_batch(&conv, codes, celsius, n);
+
+        if (binary) {
+            fwrite(celsius, sizeof(float), n, stdout);
+        } else {
+            for (size_t i = 0; i < n; i++) {
+                printf("%.2f\n", celsius[i]);
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,272 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_sim_main.c
+ * @brief Host bench of the driver with the simulated ADC.
+ *
+ * The readings of the driver are taken from a synthetic divider (or a trace 
+ * of raw codes with --trace) until the number of conversions is reached, and
+ * the throughput and the error against the exact temperature are printed as 
+ * CSV lines, as the device benchmark:
+ *
+ *     thermistor_sim --samples 10000000 --rate 1000000 --noise 4 \
+ *                    --oversampling 16 --filter ema:3 --amplitude 20 --period 0.5
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "thermistor.h"
+#include "thermistor_alloc.h"
+#include "thermistor_priv.h"
+#include "thermistor_sim.h"
+
+#define WARMUP_READINGS 64  // Readings excluded from the error, while the filter settles.
+
+static void usage(const char* name)
+{
+    fprintf(stderr, "usage: %s [--samples N] [--rate HZ] [--noise MV] [--oversampling K]\n"
+                    "       [--filter none|ema:SHIFT|median:WINDOW|cic:ORDER:SHIFT] [--equation]\n"
+                    "       [--celsius T] [--amplitude A] [--period S] [--seed S] [--trace FILE]\n", name);
+}
+
+static bool parse_filter(const char* arg, thermistor_filter_config_t* filter)
+{
+    unsigned a = 0;
+    unsigned b = 0;
+
+    memset(filter, 0, sizeof(*filter));
+
+    if (strcmp(arg, "none") == 0) {
+        filter->type = THERMISTOR_FILTER_NONE;
+    } else if (sscanf(arg, "ema:%u", &a) == 1) {
+        filter->type = THERMISTOR_FILTER_EMA;
+        filter->ema_shift = a;
+    } else if (sscanf(arg, "median:%u", &a) == 1) {
+        filter->type = THERMISTOR_FILTER_MEDIAN;
+        filter->median_window = a;
+    } else if (sscanf(arg, "cic:%u:%u", &a, &b) == 2) {
+        filter->type = THERMISTOR_FILTER_CIC;
+        filter->cic_order = a;
+        filter->cic_decimation_shift = b;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+static uint16_t* load_trace(const char* path, size_t* count)
+{
+    FILE* in = fopen(path, "r");
+    uint16_t* codes = NULL;
+    size_t capacity = 0;
+    char line[32];
+
+    *count = 0;
+    if (in == NULL) {
+        return NULL;
+    }
+
+    while (fgets(line, sizeof(line), in) != NULL) {
+        char* end;
+        unsigned long code = strtoul(line, &end, 10);
+
+        if (end == line) {
+            continue;
+        }
+
+        if (*count == capacity) {
+            capacity = (capacity == 0) ? 4096 : (capacity * 2);
+            uint16_t* grown = realloc(codes, capacity * sizeof(uint16_t));
+
+            if (grown == NULL) {
+                break;
+            }
+            codes = grown;
+        }
+
+        codes[(*count)++] = (code > 4095) ? 4095 : (uint16_t)code;
+    }
+
+    fclose(in);
+
+    return codes;
+}
+
+static double wall_seconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + (ts.tv_nsec * 1e-9);
+}
+
+int main(int argc, char** argv)
+{
+    thermistor_sim_config_t sim = {
+        .serial_resistance = 164000,
+        .nominal_resistance = 100000,
+        .nominal_temperature = 25,
+        .beta_val = 4250,
+        .vsource = 3330,
+        .celsius = 25,
+        .amplitude = 0,
+        .period_s = 1,
+        .noise_mv = 2,
+        .sample_rate_hz = 1000000,
+        .seed = 1,
+    };
+    thermistor_filter_config_t filter = {
+        .type = THERMISTOR_FILTER_NONE,
+    };
+    const char* filter_name = "none";
+    const char* trace_path = NULL;
+    uint64_t samples = 10000000;
+    uint32_t oversampling = 16;
+    bool equation = false;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool has_value = (i + 1) < argc;
+
+        if (strcmp(arg, "--equation") == 0) {
+            equation = true;
+        } else if (has_value && (strcmp(arg, "--samples") == 0)) {
+            samples = strtoull(argv[++i], NULL, 10);
+        } else if (has_value && (strcmp(arg, "--rate") == 0)) {
+            sim.sample_rate_hz = strtoul(argv[++i], NULL, 10);
+        } else if (has_value && (strcmp(arg, "--noise") == 0)) {
+            sim.noise_mv = strtof(argv[++i], NULL);
+        } else if (has_value && (strcmp(arg, "--oversampling") == 0)) {
+            oversampling = strtoul(argv[++i], NULL, 10);
+        } else if (has_value && (strcmp(arg, "--filter") == 0)) {
+            filter_name = argv[++i];
+            if (!parse_filter(filter_name, &filter)) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (has_value && (strcmp(arg, "--celsius") == 0)) {
+            sim.celsius = strtof(argv[++i], NULL);
+        } else if (has_value && (strcmp(arg, "--amplitude") == 0)) {
+            sim.amplitude = strtof(argv[++i], NULL);
+        } else if (has_value && (strcmp(arg, "--period") == 0)) {
+            sim.period_s = strtof(argv[++i], NULL);
+        } else if (has_value && (strcmp(arg, "--seed") == 0)) {
+            sim.seed = strtoul(argv[++i], NULL, 10);
+        } else if (has_value && (strcmp(arg, "--trace") == 0)) {
+            trace_path = argv[++i];
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (thermistor_sim_init(&sim) != ESP_OK) {
+        fprintf(stderr, "invalid simulation parameters\n");
+        return EXIT_FAILURE;
+    }
+
+    uint16_t* trace = NULL;
+    size_t trace_count = 0;
+
+    if (trace_path != NULL) {
+        trace = load_trace(trace_path, &trace_count);
+        if (trace_count == 0) {
+            fprintf(stderr, "no codes in %s\n", trace_path);
+            return EXIT_FAILURE;
+        }
+        thermistor_sim_set_trace(trace, trace_count);
+    }
+
+    thermistor_handle_t th = { 0 };
+
+    if ((thermistor_init(&th, ADC_CHANNEL_2, sim.serial_resistance, sim.nominal_resistance,
+                         sim.nominal_temperature, sim.beta_val, sim.vsource) != ESP_OK) ||
+        (thermistor_set_oversampling(&th, oversampling) != ESP_OK) ||
+        (thermistor_set_filter(&th, &filter) != ESP_OK)) {
+        fprintf(stderr, "invalid driver parameters\n");
+        return EXIT_FAILURE;
+    }
+
+    // The same build measures the equation without the table.
+    if (equation && th.lut_buffer[0].owned) {
+        thermistor_free((void*)th.lut_buffer[0].table);
+        th.lut = NULL;
+        th.lut_buffer[0].owned = false;
+        th.lut_buffer[1].owned = false;
+    }
+
+    printf("config,rate_hz,%u\n", (unsigned)sim.sample_rate_hz);
+    printf("config,noise_mv,%.2f\n", sim.noise_mv);
+    printf("config,oversampling,%u\n", (unsigned)oversampling);
+    printf("config,filter,%s\n", filter_name);
+    printf("config,conversion,%s\n", (th.lut != NULL) ? "lut" : "equation");
+    printf("config,source,%s\n", (trace != NULL) ? "trace" : "synthetic");
+
+    int64_t burst_us = ((int64_t)oversampling * 1000000) / sim.sample_rate_hz;
+    uint64_t readings = 0;
+    uint64_t compared = 0;
+    double sum_sq = 0;
+    double max_error = 0;
+    double start = wall_seconds();
+
+    while (thermistor_sim_conversions() < samples) {
+        thermistor_reading_t reading;
+
+        thermistor_acquire(&th, &reading);
+
+        // The exact temperature is the one in the middle of the burst.
+        if ((trace == NULL) && (++readings > WARMUP_READINGS)) {
+            double error = fabs(reading.celsius - thermistor_sim_celsius(reading.timestamp_us + (burst_us / 2)));
+
+            sum_sq += error * error;
+            if (!(error <= max_error)) {
+                max_error = error;
+            }
+            compared++;
+        }
+    }
+
+    double elapsed = wall_seconds() - start;
+    uint64_t conversions = thermistor_sim_conversions();
+
+    if (trace != NULL) {
+        readings = conversions / oversampling;
+    }
+
+    printf("sim,%llu,%llu,%.3f,%.0f,%.0f,%.4f,%.4f\n", (unsigned long long)conversions, 
+           (unsigned long long)readings, elapsed, conversions / elapsed, readings / elapsed,
+           (compared > 0) ? sqrt(sum_sq / compared) : 0, max_error);
+
+    thermistor_deinit(&th);
+    free(trace);
+
+    return EXIT_SUCCESS;
+}
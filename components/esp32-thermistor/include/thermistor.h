@@ -57,6 +57,161 @@ extern "C" {
 #include "esp_adc/adc_cali.h"
 #include "esp_adc/adc_cali_scheme.h"
 #include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_continuous.h"
+#include "soc/soc_caps.h"
+#include "hal/gpio_types.h"
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+
+#include "thermistor_alarm.h"
+#include "thermistor_convert.h"
+#include "thermistor_model.h"
+#include "thermistor_filter.h"
+#include "thermistor_ring.h"
+#include "thermistor_stats.h"
+
+#include "sdkconfig.h"
+
+/**
+ * @brief Lookup table that converts the vout of the divider to temperature.
+ *
+ * The entries are spaced (1 << shift) mV apart, and the values in between 
+ * are linearly interpolated.
+ */
+typedef struct
+{
+    const int16_t* table;           /**< Temperature in hundredths of degrees Celsius of each entry. */
+    uint16_t size;                  /**< Number of entries of the table. */
+    uint8_t shift;                  /**< Log2 of the step in mV between the entries. */
+    uint16_t capacity;              /**< Entries reserved for the table, 0 for the ROM table. */
+    bool owned;                     /**< The table was allocated by the driver (not the ROM table). */
+} thermistor_lut_t;
+
+/**
+ * @brief Fault of the divider detected from the raw code of a reading.
+ */
+typedef enum
+{
+    THERMISTOR_FAULT_NONE = 0,      /**< The raw code is inside the range of the divider. */
+    THERMISTOR_FAULT_SHORT,         /**< The thermistor (or the channel) is shorted to ground. */
+    THERMISTOR_FAULT_OPEN,          /**< The thermistor is open, or the ADC is saturated. */
+} thermistor_fault_t;
+
+/**
+ * @brief Result of one reading of the thermistor.
+ */
+typedef struct
+{
+    int64_t timestamp_us;           /**< Time of the reading from esp_timer_get_time(). */
+    uint16_t raw;                   /**< Averaged (and filtered) raw code. */
+    uint32_t vout;                  /**< Voltage in mV of thermistor channel. */
+    float resistance;               /**< Calculated thermistor resistance (0 with the lookup table). */
+    float celsius;                  /**< Temperature in degrees Celsius. */
+    uint8_t alarms;                 /**< Active alarms after the reading (THERMISTOR_ALARM_ flags). */
+    thermistor_fault_t fault;       /**< Fault of the divider, the temperature is NAN if it is not THERMISTOR_FAULT_NONE. */
+} thermistor_reading_t;
+
+/**
+ * @brief Result of a conversion, returned by value so the handle is only read.
+ */
+typedef struct
+{
+    uint32_t vout;                  /**< Voltage in mV of thermistor channel. */
+    float resistance;               /**< Calculated thermistor resistance (0 with the lookup table). */
+    float celsius;                  /**< Temperature in degrees Celsius. */
+} thermistor_conversion_t;
+
+typedef struct
+{
+    gpio_num_t gpio;                /**< GPIO that powers the divider, GPIO_NUM_NC if it is always powered. */
+    bool active_low;                /**< The divider is powered with the GPIO in low level. */
+    uint32_t settle_us;             /**< Delay between the power on and the burst, up to THERMISTOR_MAX_SETTLE_US. */
+    bool measure_vsource;           /**< Measure the excitation rail in vsource_channel with each reading. */
+    adc_channel_t vsource_channel;  /**< ADC1 channel connected to the excitation rail (through a divider). */
+    float vsource_ratio;            /**< Ratio between the rail and the voltage of vsource_channel, 1.0 without divider. */
+} thermistor_excitation_config_t;
+
+typedef struct
+{
+    gpio_num_t gpio;                /**< GPIO that powers the divider, GPIO_NUM_NC if it is always powered. */
+    uint8_t on_level;               /**< Level of the GPIO that powers the divider. */
+    uint32_t settle_us;             /**< Delay between the power on and the burst. */
+    bool measure_vsource;           /**< The rail is measured with each reading. */
+    adc_channel_t vsource_channel;  /**< Channel connected to the excitation rail. */
+    float vsource_ratio;            /**< Ratio between the rail and the voltage of vsource_channel. */
+    float vsource_mv;               /**< Last measured rail in mV, 0 before the first reading. */
+    float alarm_rail;               /**< Rail in mV (full scale code in ratiometric mode) of the raw codes of the alarms. */
+} thermistor_excitation_t;
+
+typedef struct
+{
+    float high_celsius;             /**< High setpoint, INFINITY disables the high alarm. */
+    float low_celsius;              /**< Low setpoint, -INFINITY disables the low alarm. */
+    float hysteresis;               /**< Degrees that the temperature must return to clear an alarm. */
+} thermistor_alarm_config_t;
+
+/**
+ * @brief State of the automatic selection of the attenuation.
+ */
+typedef struct
+{
+    bool enabled;                   /**< The attenuation is selected by the readings. */
+    adc_atten_t atten;              /**< Attenuation of the channel for the next burst. */
+    adc_cali_handle_t cali_h[ADC_ATTEN_DB_12]; /**< Calibration schemes of the attenuations below 12 dB. */
+    float mv_per_code;              /**< Linear fit of the 12 dB calibration, to report equivalent raw codes. */
+    float offset_mv;                /**< Offset of the linear fit in mV. */
+} thermistor_range_t;
+
+/**
+ * @brief Parameters changed at runtime, applied by the next reading of the thermistor.
+ */
+typedef struct
+{
+    portMUX_TYPE lock;              /**< Protects the pending values against the reading task. */
+    volatile uint8_t pending;       /**< Groups of parameters to apply, flags of the driver. */
+    float serial_resistance;        /**< New value of the serial resistor. */
+    float vsource;                  /**< New voltage of the source in mV. */
+    thermistor_beta_t beta;         /**< New parameters of the beta model. */
+} thermistor_params_t;
+
+/**
+ * @brief Bounds of the adaptive sampling of a thermistor.
+ */
+typedef struct
+{
+    uint32_t min_period_us;         /**< Period while the temperature changes fast. */
+    uint32_t max_period_us;         /**< Longest period in steady state. */
+    uint32_t fast_samples;          /**< Oversampling while the temperature changes fast. */
+    uint32_t slow_samples;          /**< Oversampling in steady state. */
+    float threshold;                /**< |dT/dt| in degrees Celsius per second that selects the fast rate. */
+    uint32_t window_ms;             /**< Minimum time between the readings compared to estimate dT/dt. */
+} thermistor_adaptive_config_t;
+
+/**
+ * @brief State of the adaptive sampling.
+ */
+typedef struct
+{
+    thermistor_adaptive_config_t config; /**< Bounds of the rate and the oversampling. */
+    bool enabled;                   /**< The sampling task adapts its period. */
+    bool fast;                      /**< The last estimate of dT/dt was above the threshold. */
+    int64_t anchor_us;              /**< Timestamp of the reading compared with the next ones, 0 without it. */
+    float anchor_celsius;           /**< Temperature of the anchor reading. */
+    float rate;                     /**< Last estimate of |dT/dt| in degrees Celsius per second. */
+} thermistor_adaptive_t;
+
+/**
+ * @brief State of the dual-core pipeline, private to the driver.
+ */
+typedef struct thermistor_pipeline thermistor_pipeline_t;
+
+/**
+ * @brief Stack and TCB of a driver task created statically, private to the driver.
+ */
+typedef struct thermistor_task_storage thermistor_task_storage_t;
 
 /**
  * @brief Structure to storing the thermistor instance.
@@ -65,24 +220,138 @@ extern "C" {
  */
 typedef struct  
 {
-    adc_oneshot_unit_handle_t adc_h;/**< ADC handle. */
+    adc_oneshot_unit_handle_t adc_h;/**< ADC handle, shared by all the thermistors. */
+    adc_continuous_handle_t adc_cont_h; /**< ADC continuous (DMA) handle, used instead of adc_h in continuous mode. */
     adc_channel_t channel;          /**< ADC channel pin where the thermistor is connected. */
     float serial_resistance;        /**< Value of the serial resistor connected to +3V. */
-    float nominal_resistance;       /**< Nominal resistance at 25 degrees Celsius of thermistor. */
-    float nominal_temperature;      /**< Nominal temperature of the thermistor, usually 25 degress Celsius. */
-    float beta_val;                 /**< Beta coefficient of the thermistor. */
+    float nominal_resistance;       /**< Nominal resistance at 25 degrees Celsius of thermistor (beta model). */
+    float nominal_temperature;      /**< Nominal temperature of the thermistor, usually 25 degress Celsius (beta model). */
+    float beta_val;                 /**< Beta coefficient of the thermistor (beta model). */
     float vsource;                  /**< Voltage to which the serial resistance is connected in mV, usually 3300.0. */
-    float t_resistance;             /**< Calculated thermistor resistance. */
+    float t_resistance;             /**< Calculated thermistor resistance (not updated by the lookup table). */
     uint32_t vout;                  /**< Voltage in mV of thermistor channel. */ 
+    uint32_t samples;               /**< Number of samples averaged by each reading. */
     bool calibrated;                /**< The calibration ADC was succesfull. */  
     adc_cali_handle_t adc_cali_h;   /**< Calibration information handle. */                       
+    const uint16_t* cali_table;     /**< Raw code to mV table loaded from NVS, used instead of adc_cali_h. */
+    float cali_gain;                /**< User gain correction of vout. */
+    int32_t cali_offset_mv;         /**< User offset correction of vout in mV. */
+    const thermistor_lut_t* lut;    /**< Active conversion table, NULL to use the equation of the model. */
+    thermistor_lut_t lut_buffer[2]; /**< Active and spare tables, reserved by the init when CONFIG_THERMISTOR_LUT is enabled. */
+    const thermistor_coeffs_t* coeffs; /**< Active cached coefficients of the model. */
+    thermistor_coeffs_t coeffs_buffer[2]; /**< Active and spare coefficients, the spare ones take the next change of the parameters. */
+    thermistor_filter_t filter;     /**< Filter applied to the averaged raw codes. */
+    thermistor_alarm_t alarm;       /**< Raw code thresholds of the alarms. */
+    thermistor_alarm_config_t alarm_config; /**< Setpoints of the alarms, to convert them again when the parameters change. */
+    thermistor_params_t params;     /**< Parameters waiting to be applied. */
+    volatile uint32_t params_seq;   /**< Switches of the active parameters, the conversions are repeated when it changes. */
+    thermistor_excitation_t excitation; /**< Switched power and measured rail of the divider. */
+    bool ratiometric;               /**< The resistance is calculated from the ratio of the raw codes. */
+    float full_scale_raw;           /**< Raw code that vsource would read, in ratiometric mode. */
+    thermistor_ring_t* ring;        /**< Ring where the readings are stored, or NULL. */
+    TaskHandle_t sampling_task;     /**< Background sampling task, NULL when it is not running. */
+    thermistor_task_storage_t* sampling_storage; /**< Storage of the sampling task in the arena, with CONFIG_THERMISTOR_STATIC_ALLOCATION. */
+    EventGroupHandle_t task_events; /**< Exit bits of the driver tasks of the handle, joined when they stop. */
+    StaticEventGroup_t task_events_buffer; /**< Storage of task_events. */
+    uint32_t sampling_period_us;    /**< Period of the background sampling task. */
+    esp_timer_handle_t sampling_timer; /**< Periodic timer that triggers the readings, created by the first start and kept until thermistor_deinit(). */
+    volatile uint32_t sampling_missed; /**< Periods without reading, because the previous one had not finished (or the pipeline queue was full). */
+    thermistor_adaptive_t adaptive; /**< Adaptive period and oversampling of the sampling task. */
+    thermistor_range_t range;       /**< Automatic attenuation of the channel. */
+    thermistor_pipeline_t* pipeline;/**< Acquisition and processing tasks of the pipeline, NULL when it is not running. */
+    uint16_t fault_short_raw;       /**< Raw codes up to this value are a shorted thermistor. */
+    uint16_t fault_open_raw;        /**< Raw codes from this value (at 12 dB) are an open thermistor. */
+    thermistor_fault_t fault;       /**< Fault of the last reading. */
+    uint8_t fault_skips;            /**< Group scans that skipped the channel since its last fault. */
+    volatile uint32_t latest_seq;   /**< Number of readings published, selects the buffer of the latest one. */
+    thermistor_reading_t latest[2]; /**< Double buffer of the readings published by the sampling task. */
+    volatile bool async_pending;    /**< An asynchronous reading is in progress. */
+#if CONFIG_THERMISTOR_STATS
+    thermistor_stats_t stats;       /**< Counters of the readings. */
+#endif
 } thermistor_handle_t;
 
+/**
+ * @brief Callback invoked from the driver task when an asynchronous reading ends.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   reading Result of the reading.
+ * @param   arg User argument of thermistor_async_t.
+ */
+typedef void (*thermistor_async_cb_t)(thermistor_handle_t* th, const thermistor_reading_t* reading, void* arg);
+
+/**
+ * @brief How to signal the end of an asynchronous reading, any of the members can be used.
+ */
+typedef struct
+{
+    thermistor_async_cb_t callback; /**< Function called with the reading, or NULL. */
+    void* arg;                      /**< Argument of the callback. */
+    TaskHandle_t notify_task;       /**< Task notified with xTaskNotifyGive(), or NULL. */
+    EventGroupHandle_t event_group; /**< Event group where event_bits are set, or NULL. */
+    EventBits_t event_bits;         /**< Bits to set in event_group. */
+} thermistor_async_t;
+
+/**
+ * @brief Callback invoked from the processing task of the pipeline with each batch.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   readings Readings of the batch, from the oldest. Valid only during the call.
+ * @param   count Number of readings, up to the batch of the configuration.
+ * @param   arg User argument of thermistor_pipeline_config_t.
+ */
+typedef void (*thermistor_batch_cb_t)(thermistor_handle_t* th, const thermistor_reading_t* readings, 
+                                      size_t count, void* arg);
+
+/**
+ * @brief Configuration of the dual-core pipeline.
+ */
+typedef struct
+{
+    uint32_t period_us;             /**< Period of the bursts, from THERMISTOR_MIN_SAMPLING_PERIOD_US. */
+    uint32_t batch;                 /**< Bursts processed per wake up of the processing task, up to THERMISTOR_PIPELINE_MAX_BATCH. */
+    BaseType_t acquisition_core;    /**< Core of the task that performs the bursts. */
+    BaseType_t processing_core;     /**< Core of the task that filters and converts them, a different one. */
+    thermistor_batch_cb_t callback; /**< Function called with each batch of readings, or NULL. */
+    void* arg;                      /**< Argument of the callback. */
+} thermistor_pipeline_config_t;
+
+#define THERMISTOR_MAX_OVERSAMPLING 1024                /**< Maximum number of samples averaged by each reading. */
+
+#define THERMISTOR_MAX_SETTLE_US    10000               /**< Maximum settle time of the switched divider. */
+
+#define THERMISTOR_MIN_SAMPLING_PERIOD_US   100         /**< Shortest period of the background sampling task. */
+
+#define THERMISTOR_PIPELINE_MAX_BATCH   32              /**< Maximum number of readings processed together by the pipeline. */
+
+#define THERMISTOR_FAULT_MARGIN     16                  /**< Default distance in raw codes of the fault bounds to the ends of the range. */
+
+#define THERMISTOR_FAULT_RETRY      8                   /**< A faulted thermistor is scanned again once every this number of group reads. */
+
+#define THERMISTOR_GROUP_MAX    SOC_ADC_PATT_LEN_MAX    /**< Maximum number of thermistors in a group. */
+
+/**
+ * @brief Structure to storing a group of thermistors that are sampled together.
+ *
+ * @note Call thermistor_group_init() to initialize the structure
+ */
+typedef struct
+{
+    size_t count;                                       /**< Number of thermistors in the group. */
+    thermistor_handle_t* sensors[THERMISTOR_GROUP_MAX]; /**< Initialized thermistors of the group. */
+    adc_channel_t channels[THERMISTOR_GROUP_MAX];       /**< ADC channel of each thermistor, in scan order. */
+} thermistor_group_t;
+
 /**
  * @brief Initialice the thermistor driver.
  *
  * This function configure the ADC, and calibrate the reference voltage
- * to read the vout from resitance divider.
+ * to read the vout from resitance divider. With CONFIG_THERMISTOR_LUT it also 
+ * builds the conversion table from the parameters of the thermistor.
+ * 
+ * The ADC1 unit and the calibration scheme are shared by all the thermistors, 
+ * so several instances can be initialized as long as each one uses a 
+ * different channel.
  *
  * @param   th  Pointer to store the driver information.
  * @param   channel ADC channel pin where the thermistor is connected.
@@ -94,29 +363,123 @@ typedef struct
  *
  * @return
  *      - ESP_OK: Initialization OK.
+ *      - ESP_ERR_INVALID_STATE: The channel is used by another thermistor.
+ *      - ESP_ERR_NO_MEM: There is no memory for the lookup table.
  */
 esp_err_t thermistor_init(thermistor_handle_t* th,
                           adc_channel_t channel, float serie_resistance, 
                           float nominal_resistance, float nominal_temperature, 
                           float beta_val, float vsource);
 
+/**
+ * @brief Initialice the thermistor driver with a specific model.
+ *
+ * Same as thermistor_init(), but the resistance is converted to temperature with 
+ * the beta equation, the Steinhart-Hart equation or beta segments. The 
+ * invariants of the model are calculated once and cached in the handle.
+ *
+ * @param   th  Pointer to store the driver information.
+ * @param   channel ADC channel pin where the thermistor is connected.
+ * @param   serial_resistance Value of the serial resistor connected to +3V.
+ * @param   vsource Voltage to which the series resistance is connected in mV, typically 3300.0.
+ * @param   model Configuration of the model, the segments are copied.
+ *
+ * @return
+ *      - ESP_OK: Initialization OK.
+ *      - ESP_ERR_INVALID_ARG: The configuration of the model is not valid.
+ *      - ESP_ERR_INVALID_STATE: The channel is used by another thermistor.
+ *      - ESP_ERR_NO_MEM: There is no memory for the lookup table.
+ */
+esp_err_t thermistor_init_model(thermistor_handle_t* th,
+                                adc_channel_t channel, float serial_resistance, 
+                                float vsource, const thermistor_model_config_t* model);
+
+/**
+ * @brief Release the resources of a thermistor.
+ *
+ * The channel and the shared reference channel are unregistered (the ADC 
+ * unit is deleted with the last thermistor), the calibration scheme is 
+ * released, and the tables and the timer of the sampling are freed.
+ *
+ * @param   th  Pointer of the driver information.
+ *
+ * @return
+ *      - ESP_OK: The handle can be initialized again.
+ *      - ESP_ERR_INVALID_STATE: The sampling task or an asynchronous reading is running.
+ */
+esp_err_t thermistor_deinit(thermistor_handle_t* th);
+
+/**
+ * @brief Get a copy of the counters of the readings, with CONFIG_THERMISTOR_STATS.
+ *
+ * The counters are updated without locks by the task that reads the 
+ * thermistor, a copy taken while a reading ends may mix both readings.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   stats Pointer to store the counters.
+ *
+ * @return
+ *      - ESP_OK: The counters are valid.
+ *      - ESP_ERR_NOT_SUPPORTED: The counters are disabled.
+ */
+esp_err_t thermistor_get_stats(const thermistor_handle_t* th, thermistor_stats_t* stats);
+
+/**
+ * @brief Clear the counters of the readings, for example after reporting them.
+ *
+ * @param   th  Pointer of the driver information.
+ *
+ * @return
+ *      - ESP_OK: The counters were cleared.
+ *      - ESP_ERR_NOT_SUPPORTED: The counters are disabled.
+ */
+esp_err_t thermistor_reset_stats(thermistor_handle_t* th);
+
+/**
+ * @brief Get the bytes of the static arena in use, with CONFIG_THERMISTOR_STATIC_ALLOCATION.
+ *
+ * The peak includes the scratch buffers used while loading the calibration,
+ * use it to size CONFIG_THERMISTOR_ARENA_SIZE.
+ *
+ * @param   used Pointer to store the bytes of the tables in use.
+ * @param   peak Pointer to store the maximum bytes used since boot.
+ *
+ * @return
+ *      - ESP_OK: The usage is valid.
+ *      - ESP_ERR_NOT_SUPPORTED: The tables are allocated in the heap.
+ */
+esp_err_t thermistor_get_arena_usage(size_t* used, size_t* peak);
+
 /**
  * @brief Read the vout of the resistance divider in mV.
  *
- * This function reads the value from the ADC and converts it to voltage in mV, 
- * using the calibration information from the reference.
+ * This function reads the value from the ADC, applies the filter of the 
+ * handle and converts it to voltage in mV, using the calibration information 
+ * from the reference.
+ * 
+ * In continuous mode the samples come from the DMA frames converted in the 
+ * background, so the calling task blocks without consuming CPU time.
+ *
+ * With thermistor_set_excitation() the divider is powered only during the burst,
+ * and when the rail is measured vout is referred to the nominal vsource.
  *
  * @param   th  Pointer of the driver information.
  *
  * @return
- *      - Vout in mV.
+ *      - Vout in mV, 0 if the conversion failed or the thermistor has a fault.
  */
 uint32_t thermistor_read_vout(thermistor_handle_t* th);
 
 /**
  * @brief Converts the output voltage of the divider to degrees Celsius.
  *
- * To linearize the thermistor output use the simplified Steniarth equation.
+ * To linearize the thermistor output use the model of the handle (by default
+ * the simplified Steniarth equation), or the lookup table built by thermistor_init() when CONFIG_THERMISTOR_LUT 
+ * is enabled.
+ *
+ * The resistance is stored in the t_resistance field of the handle, so the 
+ * calls from several tasks must be serialized, thermistor_vout_to_conversion() 
+ * does not write the handle.
  *
  * @param   th  Pointer of the driver information.
  * @param   vout Output voltage of the resistive divider in mV.
@@ -126,11 +489,30 @@ uint32_t thermistor_read_vout(thermistor_handle_t* th);
  */
 float thermistor_vout_to_celsius(thermistor_handle_t* th, uint32_t vout);
 
+/**
+ * @brief Converts the output voltage of the divider to hundredths of degrees Celsius.
+ *
+ * With CONFIG_THERMISTOR_LUT the conversion is a table lookup with linear
+ * interpolation that only uses integer operations, otherwise it rounds the 
+ * result of the equation.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   vout Output voltage of the resistive divider in mV.
+ *
+ * @return
+ *      - Temperature in hundredths of degrees Celsius.
+ */
+int32_t thermistor_vout_to_centi_celsius(thermistor_handle_t* th, uint32_t vout);
+
 /**
  * @brief Get temperature in degrees Celsius from the thermistor.
  *
  * This function calls thermistor_read_vout to read the voltage from the resistive 
  * divider and thermistor_vout_to_celsius to convert it to degrees Celsius.
+ * The voltage and the resistance are stored in the vout and t_resistance 
+ * fields of the handle, thermistor_acquire() returns them in the reading.
+ * When the raw code is outside the range of the divider the fault field of 
+ * the handle is set and NAN is returned (see thermistor_set_fault_range()).
  * 
  * @param   th  Pointer of the driver information.
  *
@@ -139,6 +521,558 @@ float thermistor_vout_to_celsius(thermistor_handle_t* th, uint32_t vout);
  */
 float thermistor_get_celsius(thermistor_handle_t* th);
 
+/**
+ * @brief Convert a raw code of the thermistor channel to degrees Celsius.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   adc_raw Averaged raw code, for example a sample stored by the ULP.
+ *
+ * @return
+ *      - Temperature in degrees Celsius.
+ */
+float thermistor_raw_to_celsius(const thermistor_handle_t* th, int adc_raw);
+
+/**
+ * @brief Convert the output voltage of the divider, without writing the handle.
+ *
+ * The handle is only read, so tasks on both cores can convert with the same 
+ * handle in parallel (while its configuration does not change).
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   vout Output voltage of the resistive divider in mV.
+ *
+ * @return
+ *      - Voltage, resistance and temperature of the conversion.
+ */
+thermistor_conversion_t thermistor_vout_to_conversion(const thermistor_handle_t* th, uint32_t vout);
+
+/**
+ * @brief Convert a raw code of the thermistor channel, without writing the handle.
+ *
+ * The raw code is converted as in the readings of the handle: with the ratio 
+ * to the full scale in ratiometric mode, and referred to the nominal vsource 
+ * with the last measured rail.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   adc_raw Averaged raw code of the channel.
+ *
+ * @return
+ *      - Voltage, resistance and temperature of the conversion.
+ */
+thermistor_conversion_t thermistor_raw_to_conversion(const thermistor_handle_t* th, int adc_raw);
+
+/**
+ * @brief Convert a temperature to the raw code that the thermistor channel reads.
+ *
+ * The calculation uses the inverse model and a search in the calibration, so 
+ * it is intended to precompute thresholds. Since the resistance of the 
+ * thermistor decreases with the temperature, a higher temperature gives a 
+ * lower raw code. When the rail is measured (see thermistor_set_excitation())
+ * the code is calculated for the rail of the last reading.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   celsius Temperature in degrees Celsius.
+ * @param   adc_raw Pointer to store the raw code.
+ *
+ * @return
+ *      - ESP_OK: The raw code is valid.
+ *      - ESP_ERR_INVALID_STATE: The ADC is not calibrated.
+ */
+esp_err_t thermistor_celsius_to_raw(const thermistor_handle_t* th, float celsius, int* adc_raw);
+
+/**
+ * @brief Set the number of samples averaged by each reading of the thermistor.
+ *
+ * The handle starts with CONFIG_THERMISTOR_OVERSAMPLING samples, a fast moving 
+ * sensor can use a short burst while a slow one is heavily oversampled. The 
+ * powers of two are averaged with a shift instead of a division.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   samples Number of samples, from 1 to THERMISTOR_MAX_OVERSAMPLING.
+ *
+ * @return
+ *      - ESP_OK: The oversampling was changed.
+ *      - ESP_ERR_INVALID_ARG: The number of samples is out of range.
+ */
+esp_err_t thermistor_set_oversampling(thermistor_handle_t* th, uint32_t samples);
+
+/**
+ * @brief Set the filter applied to the averaged raw code of each reading.
+ *
+ * With a filter the history of the readings is kept, so a few samples per 
+ * reading (see thermistor_set_oversampling()) reach the noise of a long burst.
+ * The history is cleared every time the filter is set.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   config Configuration of the filter, NULL disables it.
+ *
+ * @return
+ *      - ESP_OK: The filter was changed.
+ *      - ESP_ERR_INVALID_ARG: The configuration is not valid.
+ */
+esp_err_t thermistor_set_filter(thermistor_handle_t* th, const thermistor_filter_config_t* config);
+
+/**
+ * @brief Power the divider from a GPIO only during the readings, and optionally 
+ *        measure the excitation rail.
+ *
+ * The GPIO is switched on before each burst and off after it, so the divider 
+ * does not draw current from vsource nor heat the thermistor between the 
+ * readings. When the rail is measured in other channel, the vout of the 
+ * readings is referred to the nominal vsource of the handle, so the drift of 
+ * the rail does not change the calculated resistance. The rail is corrected 
+ * as the vout (see thermistor_set_correction()), so the gain of the 
+ * correction cancels in the ratio, and the raw codes of the alarms follow it.
+ *
+ * @note The settle time is a busy wait in the calling task.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   config Configuration of the excitation, NULL if the divider is always powered.
+ *
+ * @return
+ *      - ESP_OK: The excitation was configured.
+ *      - ESP_ERR_INVALID_ARG: The GPIO, the settle time or the ratio are not valid.
+ *      - ESP_ERR_INVALID_STATE: The reference channel is in use by a thermistor.
+ */
+esp_err_t thermistor_set_excitation(thermistor_handle_t* th, const thermistor_excitation_config_t* config);
+
+/**
+ * @brief Calculate the resistance from the ratio of raw codes, without the mV calibration.
+ *
+ * For a divider Rt = R1 * raw / (full_scale - raw), where full_scale is the 
+ * code that vsource would read. When the rail is measured (see 
+ * thermistor_set_excitation()) full_scale comes from the reference channel of 
+ * each reading, so the sag of the rail is cancelled; otherwise the given 
+ * full_scale_raw is used, or it is estimated once from the calibration.
+ * The readings do not call the calibration scheme, and vout is calculated as 
+ * raw * vsource / full_scale. The correction of thermistor_set_correction() 
+ * is not applied in this mode.
+ *
+ * @note The ADC offset and non-linearity are not corrected, so this mode is 
+ * best in the linear center of the range of the attenuation.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   enable Enable the ratiometric mode.
+ * @param   full_scale_raw Raw code of vsource, 0 to estimate it from the calibration.
+ *
+ * @return
+ *      - ESP_OK: The mode was changed.
+ *      - ESP_ERR_INVALID_ARG: full_scale_raw is negative.
+ *      - ESP_ERR_INVALID_STATE: full_scale_raw is 0 and the ADC is not calibrated.
+ */
+esp_err_t thermistor_set_ratiometric(thermistor_handle_t* th, bool enable, float full_scale_raw);
+
+/**
+ * @brief Get the parameters to convert the raw codes of the thermistor in batches.
+ *
+ * The calibration is approximated by the line through 1/4 and 3/4 of the 
+ * range of codes (or the ratio to the full scale in ratiometric mode), so the
+ * codes logged by the device can be converted with thermistor_convert_batch(), 
+ * for example by the host build on a server.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   conv Pointer to store the parameters.
+ *
+ * @return
+ *      - ESP_OK: The parameters are valid.
+ *      - ESP_ERR_INVALID_STATE: The ADC is not calibrated.
+ */
+esp_err_t thermistor_get_convert(const thermistor_handle_t* th, thermistor_convert_t* conv);
+
+/**
+ * @brief Set the temperature alarms checked with each reading.
+ *
+ * The setpoints are converted to raw codes here, so the readings compare the
+ * raw code without calculating the temperature. The state of the alarms is
+ * reported in the alarms field of the readings and by thermistor_read_alarm().
+ * When the rail is measured, the codes are converted again each time it 
+ * drifts more than 1/1024 from the rail of the last conversion.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   config Setpoints of the alarms, NULL disables them.
+ *
+ * @return
+ *      - ESP_OK: The alarms were changed.
+ *      - ESP_ERR_INVALID_ARG: The setpoints or the hysteresis are not valid.
+ *      - ESP_ERR_INVALID_STATE: The ADC is not calibrated.
+ */
+esp_err_t thermistor_set_alarm(thermistor_handle_t* th, const thermistor_alarm_config_t* config);
+
+/**
+ * @brief Read the thermistor and check the alarms, without converting the temperature.
+ *
+ * With the automatic attenuation the raw code is referred to the 12 dB range
+ * of the thresholds, and the attenuation of the next burst is selected, as 
+ * in the other readings.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   alarms Pointer to store the active alarms (THERMISTOR_ALARM_ flags).
+ *
+ * @return
+ *      - ESP_OK: The reading is valid.
+ */
+esp_err_t thermistor_read_alarm(thermistor_handle_t* th, uint8_t* alarms);
+
+/**
+ * @brief Select the attenuation of the channel from the voltage of each reading.
+ *
+ * A low vout only uses a small part of the 12 dB range, so the reading moves 
+ * to the lowest attenuation whose range covers the vout (up to 750 mV at 0 dB, 
+ * 1050 mV at 2.5 dB and 1300 mV at 6 dB), with smaller steps in mV and the 
+ * same oversampling. The switch up happens at 90 % of a range and the switch 
+ * down at 80 % of the lower one, and a saturated burst is repeated with the 
+ * next attenuation. The calibration scheme of each attenuation is taken from
+ * the ADC manager when the mode is enabled.
+ *
+ * The raw codes of the readings, the alarms and the ring keep the scale of 
+ * 12 dB (converted with a linear fit of its calibration), the filter restarts
+ * when the attenuation changes.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   enable True selects the attenuation automatically, false returns to 12 dB.
+ *
+ * @return
+ *      - ESP_OK: The mode was changed.
+ *      - ESP_ERR_INVALID_STATE: The handle is in ratiometric mode, the ADC is not calibrated, or the pipeline is running.
+ *      - ESP_ERR_NOT_SUPPORTED: The ADC is in continuous mode, or an attenuation has no calibration.
+ */
+esp_err_t thermistor_set_autorange(thermistor_handle_t* th, bool enable);
+
+/**
+ * @brief Set the raw codes that classify the readings as a shorted or open thermistor.
+ *
+ * The fault is detected from the unfiltered raw code of each burst, before 
+ * the conversion, so a faulted reading has vout 0, temperature NAN and its 
+ * fault field set, the filter and the alarms are not updated, and the rest 
+ * of the float pipeline is not run. By default the bounds are 
+ * THERMISTOR_FAULT_MARGIN codes from both ends of the 12 dB range; in 
+ * ratiometric mode the open bound is also kept below the full scale code.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   short_raw Raw codes up to this value are a short.
+ * @param   open_raw Raw codes from this value are an open, on the 12 dB scale.
+ *
+ * @return
+ *      - ESP_OK: The bounds were changed.
+ *      - ESP_ERR_INVALID_ARG: short_raw is not lower than open_raw.
+ */
+esp_err_t thermistor_set_fault_range(thermistor_handle_t* th, uint16_t short_raw, uint16_t open_raw);
+
+/**
+ * @brief Change the divider of the thermistor at runtime.
+ *
+ * The values are only stored here, and the next reading (or 
+ * thermistor_apply_params()) applies them and rebuilds the data that depends 
+ * on them: the lookup table and the raw codes of the alarms. So it is cheap 
+ * to call from another task while the thermistor is being sampled, and no 
+ * reading mixes the old and the new parameters. The conversion functions
+ * use the parameters applied by the last reading.
+ *
+ * @note Write the fields of the handle directly only before the first reading.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   serial_resistance Value of the serial resistor.
+ * @param   vsource Voltage to which the serial resistor is connected in mV.
+ *
+ * @return
+ *      - ESP_OK: The parameters will be applied by the next reading.
+ *      - ESP_ERR_INVALID_ARG: The resistance or the voltage are not positive.
+ */
+esp_err_t thermistor_set_divider(thermistor_handle_t* th, float serial_resistance, float vsource);
+
+/**
+ * @brief Change the parameters of the beta model at runtime.
+ *
+ * As with thermistor_set_divider(), the next reading recalculates the 
+ * coefficients of the model, the lookup table and the alarms.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   beta New parameters of the equation.
+ *
+ * @return
+ *      - ESP_OK: The parameters will be applied by the next reading.
+ *      - ESP_ERR_INVALID_ARG: The resistance or the beta coefficient are not positive.
+ *      - ESP_ERR_INVALID_STATE: The thermistor does not use the beta model.
+ */
+esp_err_t thermistor_set_beta(thermistor_handle_t* th, const thermistor_beta_t* beta);
+
+/**
+ * @brief Apply the parameters changed at runtime, instead of waiting for the next reading.
+ *
+ * The coefficients and the lookup table are rebuilt in the spare copies 
+ * reserved by the init, without allocating memory, and replace the active 
+ * ones under the lock of the parameters; a conversion of another task that
+ * overlaps the switch is repeated, so it uses either the old or the new 
+ * parameters. If vsource needs more entries than the 
+ * reserved ones, the new table has a longer step. The ROM table of 
+ * CONFIG_THERMISTOR_LUT_ROM has no spare: the change is applied with the 
+ * equation of the model, and an error is logged and returned.
+ *
+ * @note Call it from the task that reads the thermistor.
+ *
+ * @param   th  Pointer of the driver information.
+ *
+ * @return
+ *      - ESP_OK: The parameters are applied.
+ *      - ESP_ERR_NO_MEM: There is no spare lookup table, the equation of the model is used.
+ */
+esp_err_t thermistor_apply_params(thermistor_handle_t* th);
+
+/**
+ * @brief Set a board correction of the calibrated voltage, vout = vout * gain + offset_mv.
+ *
+ * It is applied after the ADC calibration, for example to compensate the 
+ * tolerance of the serial resistor measured with a two-point calibration.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   gain Gain of the correction, 1.0 has no effect.
+ * @param   offset_mv Offset of the correction in mV.
+ *
+ * @return
+ *      - ESP_OK: The correction was changed.
+ *      - ESP_ERR_INVALID_ARG: The gain is not a positive number.
+ */
+esp_err_t thermistor_set_correction(thermistor_handle_t* th, float gain, int32_t offset_mv);
+
+/**
+ * @brief Store the calibration of the thermistor in NVS.
+ *
+ * The calibration scheme is sampled in a raw code to mV table, which is stored 
+ * with the correction and the lookup table in a blob validated by a CRC. With 
+ * CONFIG_THERMISTOR_NVS_CACHE enabled, thermistor_init() loads the blob of the
+ * channel instead of creating the calibration scheme and the lookup table, as 
+ * long as the parameters of the thermistor did not change.
+ *
+ * @note The NVS must be initialized with nvs_flash_init() by the application.
+ *
+ * @param   th  Pointer of the driver information.
+ *
+ * @return
+ *      - ESP_OK: The calibration was stored.
+ *      - ESP_ERR_INVALID_STATE: The ADC is not calibrated.
+ *      - ESP_ERR_NOT_SUPPORTED: CONFIG_THERMISTOR_NVS_CACHE is disabled.
+ */
+esp_err_t thermistor_save_calibration(const thermistor_handle_t* th);
+
+/**
+ * @brief Remove the calibration of the thermistor stored in NVS.
+ *
+ * @param   th  Pointer of the driver information.
+ *
+ * @return
+ *      - ESP_OK: The calibration was removed, or it was not stored.
+ *      - ESP_ERR_NOT_SUPPORTED: CONFIG_THERMISTOR_NVS_CACHE is disabled.
+ */
+esp_err_t thermistor_erase_calibration(const thermistor_handle_t* th);
+
+/**
+ * @brief Attach a ring where every reading of the thermistor is stored.
+ *
+ * The ring is statically allocated by the application and emptied here, then 
+ * the history is fetched in bulk with thermistor_drain() or 
+ * thermistor_ring_peek(). Only one task can consume the ring.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   ring Pointer of the ring, NULL detaches it.
+ */
+void thermistor_set_ring(thermistor_handle_t* th, thermistor_ring_t* ring);
+
+/**
+ * @brief Start a driver task that refreshes the readings in the background.
+ *
+ * The task reads the thermistor every period and publishes the result in a 
+ * double buffer of the handle, so any number of tasks can get the latest 
+ * reading with thermistor_get_latest() without blocking or taking a mutex.
+ * The readings are triggered by a timer, see thermistor_start_sampling_us().
+ *
+ * With CONFIG_THERMISTOR_STATIC_ALLOCATION the stack and the TCB of the task 
+ * are taken from the arena until the stop. The esp_timer can only be created 
+ * in the heap, so the first start of the handle creates it, and it is kept 
+ * for the next starts until thermistor_deinit().
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   period_ms Period between readings in ms.
+ *
+ * @return
+ *      - ESP_OK: The task is running.
+ *      - ESP_ERR_INVALID_STATE: The task is already running.
+ *      - ESP_ERR_NO_MEM: The task or the timer could not be created.
+ */
+esp_err_t thermistor_start_sampling(thermistor_handle_t* th, uint32_t period_ms);
+
+/**
+ * @brief Start the background sampling task with a period in microseconds.
+ *
+ * The readings start at the exact periods of an esp_timer, independently of 
+ * the time of each burst, and carry the timestamp of their start, so with a
+ * ring (see thermistor_set_ring()) they form an evenly spaced stream. The 
+ * period must be longer than the burst, the periods that find the previous 
+ * reading running are skipped and counted in sampling_missed.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   period_us Period between readings in us, from THERMISTOR_MIN_SAMPLING_PERIOD_US.
+ *
+ * @return
+ *      - ESP_OK: The task is running.
+ *      - ESP_ERR_INVALID_ARG: The period is too short.
+ *      - ESP_ERR_INVALID_STATE: The task is already running.
+ *      - ESP_ERR_NO_MEM: The task or the timer could not be created.
+ */
+esp_err_t thermistor_start_sampling_us(thermistor_handle_t* th, uint32_t period_us);
+
+/**
+ * @brief Adapt the period and the oversampling of the sampling task to the rate of change.
+ *
+ * Every window the task estimates |dT/dt| from the readings. Above the 
+ * threshold it switches to the minimum period with the fast oversampling, a
+ * short burst that keeps up with a ramp. Below half the threshold it returns 
+ * to the slow oversampling and doubles the period on each window, up to the 
+ * maximum. In between the rate is kept, as hysteresis.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   config Bounds of the adaptation, NULL keeps the current period and oversampling.
+ *
+ * @return
+ *      - ESP_OK: The adaptation is configured.
+ *      - ESP_ERR_INVALID_ARG: The bounds are not valid.
+ */
+esp_err_t thermistor_set_adaptive(thermistor_handle_t* th, const thermistor_adaptive_config_t* config);
+
+/**
+ * @brief Stop the background sampling task, waiting for the current reading to end.
+ *
+ * @param   th  Pointer of the driver information.
+ *
+ * @return
+ *      - ESP_OK: The task was deleted.
+ *      - ESP_ERR_INVALID_STATE: The task is not running, or the pipeline is running instead.
+ */
+esp_err_t thermistor_stop_sampling(thermistor_handle_t* th);
+
+/**
+ * @brief Start the sampling with the acquisition and the processing on different cores.
+ *
+ * A task pinned to acquisition_core performs the bursts on each period of a
+ * timer (directly on the DMA frames in continuous mode), and only pushes the 
+ * raw codes to a lock-free queue of CONFIG_THERMISTOR_PIPELINE_DEPTH bursts. 
+ * A task pinned to processing_core wakes up every batch bursts, filters and 
+ * converts them, updates the alarms and the ring, publishes the last reading
+ * (see thermistor_get_latest()) and passes the batch to the callback, for 
+ * example to encode the telemetry. So the period of the bursts does not 
+ * depend on the processing. The bursts that find the queue full are counted
+ * in sampling_missed.
+ *
+ * The readings with errors of the ADC are not queued. The adaptive sampling
+ * is not applied, and the automatic attenuation can't be used.
+ *
+ * The pipeline uses the timer of the handle, as thermistor_start_sampling().
+ * With CONFIG_THERMISTOR_STATIC_ALLOCATION its state and the stacks of both 
+ * tasks are taken from the arena until the stop.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   config Configuration of the pipeline, it is copied.
+ *
+ * @return
+ *      - ESP_OK: The pipeline is running.
+ *      - ESP_ERR_INVALID_ARG: The period, the batch or the cores are not valid.
+ *      - ESP_ERR_INVALID_STATE: The sampling or an asynchronous reading is running, or the attenuation is automatic.
+ *      - ESP_ERR_NO_MEM: The tasks, the queue or the timer could not be created.
+ *      - ESP_ERR_NOT_SUPPORTED: CONFIG_THERMISTOR_PIPELINE is not enabled.
+ */
+esp_err_t thermistor_start_pipeline(thermistor_handle_t* th, const thermistor_pipeline_config_t* config);
+
+/**
+ * @brief Stop the pipeline, after the processing of the queued bursts.
+ *
+ * @param   th  Pointer of the driver information.
+ *
+ * @return
+ *      - ESP_OK: The tasks were deleted.
+ *      - ESP_ERR_INVALID_STATE: The pipeline is not running.
+ */
+esp_err_t thermistor_stop_pipeline(thermistor_handle_t* th);
+
+/**
+ * @brief Get the latest reading published by the background sampling task.
+ *
+ * This function never blocks, copy the reading in O(1) and is safe to call 
+ * from any task (or core) at the same time.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   reading Pointer to store the reading.
+ *
+ * @return
+ *      - ESP_OK: The reading is valid.
+ *      - ESP_ERR_INVALID_STATE: No reading has been published yet.
+ */
+esp_err_t thermistor_get_latest(const thermistor_handle_t* th, thermistor_reading_t* reading);
+
+/**
+ * @brief Start a reading that is performed by the driver task, and return immediately.
+ *
+ * When the vout and the temperature are ready the reading is published (see 
+ * thermistor_get_latest()) and the completion is signaled as configured in done.
+ * It can't be used while the background sampling task is running. The reading 
+ * is in progress until the completion is signaled, so a new one can't be 
+ * started from the callback, and a task woken by the completion on the other 
+ * core can still get ESP_ERR_INVALID_STATE for a moment.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   done How to signal the end of the reading, it is copied.
+ *
+ * @return
+ *      - ESP_OK: The reading was queued.
+ *      - ESP_ERR_INVALID_STATE: There is a reading in progress, or the sampling task is running.
+ *      - ESP_ERR_NO_MEM: The driver task or its queue could not be created.
+ */
+esp_err_t thermistor_read_async(thermistor_handle_t* th, const thermistor_async_t* done);
+
+/**
+ * @brief Initialize a group of thermistors to read them in a single scan.
+ *
+ * @param   group  Pointer to store the group information.
+ * @param   sensors Array of thermistors already initialized with thermistor_init().
+ * @param   count Number of thermistors, up to THERMISTOR_GROUP_MAX.
+ *
+ * @return
+ *      - ESP_OK: Initialization OK.
+ *      - ESP_ERR_INVALID_ARG: The count is out of range.
+ */
+esp_err_t thermistor_group_init(thermistor_group_t* group, 
+                                thermistor_handle_t* const* sensors, size_t count);
+
+/**
+ * @brief Get the temperature of all the thermistors of a group.
+ *
+ * The conversions of the channels are interleaved in one burst (from the 
+ * continuous pattern table in DMA mode) instead of a full burst per thermistor, 
+ * and the vout and resistance of each handle are updated as with 
+ * thermistor_get_celsius(). The switched dividers are powered together, and 
+ * the reference channels of the rails are added to the same burst.
+ *
+ * The burst takes the conversions of one reading: the largest oversampling 
+ * of the group is split between the scanned channels (at least one each), so 
+ * the latency does not grow with the number of thermistors. Each channel 
+ * averages fewer samples than a reading of its own, so its noise grows with 
+ * the square root of the channels; raise the oversampling (see 
+ * thermistor_set_oversampling()) or filter the readings to compensate, at the 
+ * cost of a longer scan.
+ *
+ * A thermistor whose last reading had a fault (see thermistor_set_fault_range()) 
+ * is left out of the burst, and scanned again once every THERMISTOR_FAULT_RETRY 
+ * reads of the group to detect when it is repaired. Its temperature is NAN, 
+ * and the fault field of the handle tells the cause.
+ *
+ * @param   group  Pointer of the group information.
+ * @param   celsius Array of group->count elements to store the temperatures.
+ *
+ * @return
+ *      - ESP_OK: All the temperatures are valid.
+ *      - ESP_ERR_INVALID_RESPONSE: Some thermistors have a fault, the rest of the temperatures are valid.
+ *      - ESP_ERR_INVALID_SIZE: The thermistors and the reference channels exceed THERMISTOR_GROUP_MAX.
+ */
+esp_err_t thermistor_group_read(thermistor_group_t* group, float* celsius);
+
 /**
  * @brief Convert temperature of degrees Celsius to Fahrenheit.
  *
@@ -0,0 +1,112 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_alarm.h
+ * @brief Temperature alarms compared with the raw codes of a thermistor.
+ *
+ * The setpoints are converted to raw codes once, when the alarm is configured
+ * (see thermistor_set_alarm()), so each reading is checked with an integer 
+ * comparison and without calculating the temperature. The resistance of the 
+ * thermistor decreases with the temperature, so the high alarm is set when the
+ * raw code falls below its threshold, and the low alarm when the raw code 
+ * rises above its threshold. Each alarm has a clear threshold for hysteresis.
+ *
+ * This module does not depend on the ESP-IDF.
+ */
+
+#ifndef __THERMISTOR_ALARM_H__
+#define __THERMISTOR_ALARM_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define THERMISTOR_ALARM_HIGH   (1 << 0)    /**< The temperature is above the high setpoint. */
+#define THERMISTOR_ALARM_LOW    (1 << 1)    /**< The temperature is below the low setpoint. */
+
+/**
+ * @brief Raw code thresholds and state of the alarms.
+ */
+typedef struct
+{
+    uint16_t high_set;              /**< The high alarm is set below this code, 0 disables it. */
+    uint16_t high_clear;            /**< The high alarm is cleared at or above this code. */
+    uint16_t low_set;               /**< The low alarm is set above this code, UINT16_MAX disables it. */
+    uint16_t low_clear;             /**< The low alarm is cleared at or below this code. */
+    uint8_t active;                 /**< THERMISTOR_ALARM_HIGH and THERMISTOR_ALARM_LOW flags. */
+} thermistor_alarm_t;
+
+/**
+ * @brief Disable both alarms.
+ *
+ * @param   alarm  Pointer of the alarm.
+ */
+static inline void thermistor_alarm_disable(thermistor_alarm_t* alarm)
+{
+    alarm->high_set = 0;
+    alarm->high_clear = 0;
+    alarm->low_set = UINT16_MAX;
+    alarm->low_clear = UINT16_MAX;
+    alarm->active = 0;
+}
+
+/**
+ * @brief Compare a raw code with the thresholds.
+ *
+ * @param   alarm  Pointer of the alarm.
+ * @param   raw  Averaged raw code of the thermistor.
+ *
+ * @return
+ *      - Active alarms after the raw code.
+ */
+static inline uint8_t thermistor_alarm_update(thermistor_alarm_t* alarm, uint16_t raw)
+{
+    uint8_t active = alarm->active;
+
+    if (raw < alarm->high_set) {
+        active |= THERMISTOR_ALARM_HIGH;
+    } else if (raw >= alarm->high_clear) {
+        active &= ~THERMISTOR_ALARM_HIGH;
+    }
+
+    if (raw > alarm->low_set) {
+        active |= THERMISTOR_ALARM_LOW;
+    } else if (raw <= alarm->low_clear) {
+        active &= ~THERMISTOR_ALARM_LOW;
+    }
+
+    alarm->active = active;
+
+    return active;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __THERMISTOR_ALARM_H__ */
@@ -0,0 +1,101 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_convert.h
+ * @brief Batch conversion of raw codes to temperature.
+ *
+ * The conversion uses the same model of the driver, with the calibration of 
+ * the ADC approximated by a line (mV = code * mv_per_code + offset_mv). The 
+ * batch loop has no branches, so the compiler can vectorize it; on the host 
+ * build (see host/CMakeLists.txt) it runs on SIMD units, with the vector 
+ * logf of the C library.
+ *
+ * To convert on a server the codes logged by a device, get the parameters 
+ * from the device with thermistor_get_convert(). This module does not depend 
+ * on the ESP-IDF.
+ */
+
+#ifndef __THERMISTOR_CONVERT_H__
+#define __THERMISTOR_CONVERT_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "thermistor_model.h"
+
+/**
+ * @brief Parameters of the conversion.
+ *
+ * @note Call thermistor_convert_init() to initialize the structure
+ */
+typedef struct
+{
+    thermistor_coeffs_t coeffs;     /**< Coefficients of the model. */
+    float serial_resistance;        /**< Value of the serial resistor connected to vsource. */
+    float vsource;                  /**< Voltage of the source of the divider in mV. */
+    float mv_per_code;              /**< Gain of the calibration, mV = code * mv_per_code + offset_mv. */
+    float offset_mv;                /**< Offset of the calibration in mV. */
+} thermistor_convert_t;
+
+/**
+ * @brief Initialize the parameters of the conversion.
+ *
+ * @param   conv  Pointer to store the parameters.
+ * @param   serial_resistance Value of the serial resistor in ohm.
+ * @param   vsource Voltage of the source of the divider in mV.
+ * @param   model Configuration of the model of the thermistor.
+ * @param   mv_per_code Gain of the calibration of the ADC.
+ * @param   offset_mv Offset of the calibration of the ADC.
+ *
+ * @return
+ *      - true: The parameters are valid.
+ */
+bool thermistor_convert_init(thermistor_convert_t* conv, float serial_resistance, float vsource,
+                             const thermistor_model_config_t* model, float mv_per_code, float offset_mv);
+
+/**
+ * @brief Convert a batch of raw codes to degrees Celsius.
+ *
+ * The voltages are saturated half a mV inside the rails, so the codes of an 
+ * open or shorted thermistor give finite temperatures at the ends of the range.
+ *
+ * @param   conv  Parameters of the conversion.
+ * @param   codes Raw codes to convert.
+ * @param   out Array of n elements to store the temperatures, it must not overlap codes.
+ * @param   n Number of codes.
+ */
+void thermistor_convert_batch(const thermistor_convert_t* conv, const uint16_t* codes, 
+                              float* out, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __THERMISTOR_CONVERT_H__ */
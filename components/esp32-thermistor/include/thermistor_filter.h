@@ -0,0 +1,134 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_filter.h
+ * @brief Streaming filters applied to the averaged raw codes of a thermistor.
+ *
+ * Each reading of a thermistor averages a burst of samples. Instead of 
+ * throwing away the history, a filter keeps state between the readings, so a 
+ * short burst per reading plus the filter reaches the noise floor of a long 
+ * burst at a fraction of the ADC time:
+ *
+ * - Exponential moving average, with a power of two weight.
+ * - Sliding median, that rejects the spikes without smoothing the edges.
+ * - Cascaded integrator-comb decimator, a boxcar of several orders that 
+ *   updates its output every decimation readings.
+ *
+ * All the filters use integer arithmetic only. This module does not depend 
+ * on the ESP-IDF.
+ */
+
+#ifndef __THERMISTOR_FILTER_H__
+#define __THERMISTOR_FILTER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define THERMISTOR_FILTER_MEDIAN_MAX    9   /**< Maximum window of the median filter. */
+#define THERMISTOR_FILTER_CIC_MAX_ORDER 4   /**< Maximum number of integrator-comb stages. */
+#define THERMISTOR_FILTER_CIC_MAX_GAIN  20  /**< Maximum growth in bits, order * log2(decimation). */
+
+/**
+ * @brief Type of filter.
+ */
+typedef enum 
+{
+    THERMISTOR_FILTER_NONE = 0,     /**< The raw codes are used as they are read. */
+    THERMISTOR_FILTER_EMA,          /**< Exponential moving average. */
+    THERMISTOR_FILTER_MEDIAN,       /**< Sliding median. */
+    THERMISTOR_FILTER_CIC,          /**< Cascaded integrator-comb decimator. */
+} thermistor_filter_type_t;
+
+/**
+ * @brief Configuration of the filter.
+ */
+typedef struct
+{
+    thermistor_filter_type_t type;  /**< Type of filter. */
+    uint8_t ema_shift;              /**< EMA weight of the new code, 1 / (1 << ema_shift), from 1 to 8. */
+    uint8_t median_window;          /**< Median window, odd from 3 to THERMISTOR_FILTER_MEDIAN_MAX. */
+    uint8_t cic_order;              /**< CIC stages, from 1 to THERMISTOR_FILTER_CIC_MAX_ORDER. */
+    uint8_t cic_decimation_shift;   /**< CIC decimation, 1 << cic_decimation_shift readings. */
+} thermistor_filter_config_t;
+
+/**
+ * @brief State of the filter.
+ *
+ * @note Call thermistor_filter_init() to initialize the structure
+ */
+typedef struct
+{
+    thermistor_filter_config_t config;                      /**< Configuration of the filter. */
+    bool primed;                                            /**< The state is initialized with a code. */
+    uint16_t output;                                        /**< Last output of the filter. */
+    int32_t ema;                                            /**< EMA state, with 16 fractional bits. */
+    uint8_t median_pos;                                     /**< Position of the next code in the window. */
+    uint8_t median_count;                                   /**< Number of codes in the window. */
+    uint16_t median[THERMISTOR_FILTER_MEDIAN_MAX];          /**< Window of the median filter. */
+    uint32_t phase;                                         /**< Readings since the last CIC output. */
+    uint8_t cic_outputs;                                    /**< CIC outputs since priming, until the combs settle. */
+    uint32_t integrator[THERMISTOR_FILTER_CIC_MAX_ORDER];   /**< CIC integrators (modulo 2^32). */
+    uint32_t comb[THERMISTOR_FILTER_CIC_MAX_ORDER];         /**< CIC comb delays. */
+} thermistor_filter_t;
+
+/**
+ * @brief Initialize the filter.
+ *
+ * @param   filter  Pointer to store the filter state.
+ * @param   config  Configuration of the filter, NULL is the same as THERMISTOR_FILTER_NONE.
+ *
+ * @return
+ *      - true: The configuration is valid.
+ *      - false: The configuration is not valid, the filter is not modified.
+ */
+bool thermistor_filter_init(thermistor_filter_t* filter, const thermistor_filter_config_t* config);
+
+/**
+ * @brief Discard the history of the filter, the next code primes it again.
+ *
+ * @param   filter  Pointer of the filter state.
+ */
+void thermistor_filter_reset(thermistor_filter_t* filter);
+
+/**
+ * @brief Feed a new raw code to the filter.
+ *
+ * @param   filter  Pointer of the filter state.
+ * @param   raw  Averaged raw code of the reading.
+ *
+ * @return
+ *      - Filtered raw code.
+ */
+uint16_t thermistor_filter_update(thermistor_filter_t* filter, uint16_t raw);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __THERMISTOR_FILTER_H__ */
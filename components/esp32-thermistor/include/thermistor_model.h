@@ -0,0 +1,183 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_model.h
+ * @brief Models that convert the resistance of the thermistor to temperature.
+ *
+ * The simplified beta equation is accurate close to the nominal temperature, 
+ * the three coefficient Steinhart-Hart equation and the beta segments (one
+ * coefficient per temperature range, as published by the manufacturers for 
+ * 25/50, 25/85 ...) keep the accuracy over a wider range.
+ *
+ * The invariants of each model are calculated once by thermistor_model_prepare(), 
+ * so the conversion only has a logarithm, multiplications and one division. 
+ * They are stored and evaluated in double, as the original equation, unless 
+ * CONFIG_THERMISTOR_MATH_FLOAT selects the single precision path.
+ *
+ * This module does not depend on the ESP-IDF.
+ */
+
+#ifndef __THERMISTOR_MODEL_H__
+#define __THERMISTOR_MODEL_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+#define THERMISTOR_MODEL_MAX_SEGMENTS   4   /**< Maximum number of beta segments. */
+
+/**
+ * @brief Arithmetic of the cached coefficients and of the conversion.
+ */
+#if CONFIG_THERMISTOR_MATH_FLOAT
+typedef float thermistor_coeff_t;
+#else
+typedef double thermistor_coeff_t;
+#endif
+
+/**
+ * @brief Equation used to convert the resistance to temperature.
+ */
+typedef enum 
+{
+    THERMISTOR_MODEL_BETA = 0,          /**< Simplified Steinhart equation with the beta coefficient. */
+    THERMISTOR_MODEL_STEINHART_HART,    /**< 1/T = A + B ln(R) + C ln(R)^3. */
+    THERMISTOR_MODEL_BETA_SEGMENTS,     /**< Beta equation with a coefficient per temperature range. */
+} thermistor_model_t;
+
+/**
+ * @brief Parameters of the simplified beta equation.
+ */
+typedef struct
+{
+    float nominal_resistance;       /**< Resistance of the thermistor at the nominal temperature. */
+    float nominal_temperature;      /**< Nominal temperature in degrees Celsius, usually 25. */
+    float beta_val;                 /**< Beta coefficient of the thermistor. */
+} thermistor_beta_t;
+
+/**
+ * @brief Beta segment, used up to its maximum temperature.
+ */
+typedef struct
+{
+    float max_temperature;          /**< Upper limit of the segment in degrees Celsius (ignored in the last one). */
+    thermistor_beta_t beta;         /**< Parameters of the equation in the segment. */
+} thermistor_segment_t;
+
+/**
+ * @brief Configuration of the model of the thermistor.
+ */
+typedef struct
+{
+    thermistor_model_t model;       /**< Equation to use. */
+    union {
+        thermistor_beta_t beta;     /**< THERMISTOR_MODEL_BETA parameters. */
+        struct {
+            float a;                /**< A coefficient. */
+            float b;                /**< B coefficient. */
+            float c;                /**< C coefficient. */
+        } steinhart_hart;           /**< THERMISTOR_MODEL_STEINHART_HART coefficients (R in ohm, T in Kelvin). */
+        struct {
+            const thermistor_segment_t* segments;   /**< Segments sorted by ascending temperature. */
+            size_t count;                           /**< Number of segments, up to THERMISTOR_MODEL_MAX_SEGMENTS. */
+        } segmented;                /**< THERMISTOR_MODEL_BETA_SEGMENTS parameters. */
+    };
+} thermistor_model_config_t;
+
+/**
+ * @brief Invariants of a beta equation: 1/T = inv_t0 + inv_beta * (ln(R) - ln_r0).
+ */
+typedef struct
+{
+    thermistor_coeff_t inv_t0;      /**< 1 / (T0 + 273.15). */
+    thermistor_coeff_t inv_beta;    /**< 1 / beta. */
+    thermistor_coeff_t ln_r0;       /**< ln(R0). */
+    thermistor_coeff_t r_min;       /**< Resistance at the upper temperature of the segment. */
+} thermistor_beta_coeffs_t;
+
+/**
+ * @brief Cached coefficients of the model.
+ *
+ * @note Call thermistor_model_prepare() to initialize the structure
+ */
+typedef struct
+{
+    thermistor_model_t model;                                   /**< Equation to use. */
+    thermistor_coeff_t a;                                       /**< Steinhart-Hart A coefficient. */
+    thermistor_coeff_t b;                                       /**< Steinhart-Hart B coefficient. */
+    thermistor_coeff_t c;                                       /**< Steinhart-Hart C coefficient. */
+    uint8_t count;                                              /**< Number of beta segments (1 for the beta model). */
+    thermistor_beta_coeffs_t beta[THERMISTOR_MODEL_MAX_SEGMENTS]; /**< Beta invariants by segment. */
+} thermistor_coeffs_t;
+
+/**
+ * @brief Calculate the invariants of the model.
+ *
+ * @param   coeffs  Pointer to store the coefficients.
+ * @param   config  Configuration of the model.
+ *
+ * @return
+ *      - true: The configuration is valid.
+ */
+bool thermistor_model_prepare(thermistor_coeffs_t* coeffs, const thermistor_model_config_t* config);
+
+/**
+ * @brief Convert the resistance of the thermistor to degrees Celsius.
+ *
+ * @param   coeffs  Coefficients prepared with thermistor_model_prepare().
+ * @param   resistance Resistance of the thermistor in ohm.
+ *
+ * @return
+ *      - Temperature in degrees Celsius.
+ */
+float thermistor_model_celsius(const thermistor_coeffs_t* coeffs, float resistance);
+
+/**
+ * @brief Convert a temperature to the resistance of the thermistor, the inverse of 
+ *        thermistor_model_celsius().
+ *
+ * It is intended to precompute thresholds, the calculation is not optimized.
+ *
+ * @param   coeffs  Coefficients prepared with thermistor_model_prepare().
+ * @param   celsius Temperature in degrees Celsius.
+ *
+ * @return
+ *      - Resistance of the thermistor in ohm.
+ */
+float thermistor_model_resistance(const thermistor_coeffs_t* coeffs, float celsius);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __THERMISTOR_MODEL_H__ */
@@ -0,0 +1,151 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_ring.h
+ * @brief Ring of timestamped samples for the bulk readout of the history.
+ *
+ * The ring is statically allocated by the application and attached to a 
+ * thermistor with thermistor_set_ring(), the driver stores every reading and 
+ * a logger fetches the history in one call with thermistor_drain() (copy) or 
+ * thermistor_ring_peek() and thermistor_ring_consume() (in place).
+ *
+ * The driver is the only producer and the logger the only consumer, so the 
+ * ring is lock-free. When it is full the new samples are dropped and counted.
+ *
+ * This module does not depend on the ESP-IDF.
+ */
+
+#ifndef __THERMISTOR_RING_H__
+#define __THERMISTOR_RING_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+#ifndef CONFIG_THERMISTOR_RING_ORDER
+#define CONFIG_THERMISTOR_RING_ORDER 8
+#endif
+
+#define THERMISTOR_RING_SIZE    (1UL << CONFIG_THERMISTOR_RING_ORDER)   /**< Capacity of the ring in samples. */
+
+/**
+ * @brief Reading stored in the ring.
+ */
+typedef struct __attribute__((packed))
+{
+    int64_t timestamp_us;           /**< Time of the reading from esp_timer_get_time(). */
+    uint16_t raw;                   /**< Averaged (and filtered) raw code. */
+    uint16_t vout;                  /**< Voltage in mV of thermistor channel. */
+    int16_t centi_celsius;          /**< Temperature in hundredths of degrees Celsius. */
+} thermistor_sample_t;
+
+/**
+ * @brief Ring of samples.
+ *
+ * @note Call thermistor_ring_init() to initialize the structure
+ */
+typedef struct
+{
+    volatile uint32_t head;                         /**< Samples written since init (producer). */
+    volatile uint32_t tail;                         /**< Samples consumed since init (consumer). */
+    volatile uint32_t dropped;                      /**< Samples lost because the ring was full. */
+    thermistor_sample_t buffer[THERMISTOR_RING_SIZE]; /**< Storage of the samples. */
+} thermistor_ring_t;
+
+/**
+ * @brief Empty the ring.
+ *
+ * @param   ring  Pointer of the ring.
+ */
+void thermistor_ring_init(thermistor_ring_t* ring);
+
+/**
+ * @brief Store a sample in the ring (producer).
+ *
+ * @param   ring  Pointer of the ring.
+ * @param   sample Sample to store.
+ *
+ * @return
+ *      - 1: The sample was stored.
+ *      - 0: The ring is full, the sample was dropped.
+ */
+int thermistor_ring_push(thermistor_ring_t* ring, const thermistor_sample_t* sample);
+
+/**
+ * @brief Number of samples waiting in the ring.
+ *
+ * @param   ring  Pointer of the ring.
+ *
+ * @return
+ *      - Number of samples.
+ */
+size_t thermistor_ring_count(const thermistor_ring_t* ring);
+
+/**
+ * @brief Copy and consume up to max samples of the ring (consumer).
+ *
+ * @param   ring  Pointer of the ring.
+ * @param   out Array to store the samples, oldest first.
+ * @param   max Number of elements of out.
+ *
+ * @return
+ *      - Number of samples copied.
+ */
+size_t thermistor_drain(thermistor_ring_t* ring, thermistor_sample_t* out, size_t max);
+
+/**
+ * @brief Get the oldest contiguous span of samples without copying them (consumer).
+ *
+ * When the samples wrap around the end of the buffer, a second call after 
+ * thermistor_ring_consume() returns the rest.
+ *
+ * @param   ring  Pointer of the ring.
+ * @param   span Pointer to store the address of the first sample.
+ *
+ * @return
+ *      - Number of samples of the span.
+ */
+size_t thermistor_ring_peek(thermistor_ring_t* ring, const thermistor_sample_t** span);
+
+/**
+ * @brief Release the samples of a span obtained with thermistor_ring_peek() (consumer).
+ *
+ * @param   ring  Pointer of the ring.
+ * @param   count Number of samples to release.
+ */
+void thermistor_ring_consume(thermistor_ring_t* ring, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __THERMISTOR_RING_H__ */
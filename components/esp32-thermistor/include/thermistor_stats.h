@@ -0,0 +1,135 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_stats.h
+ * @brief Counters and latency histograms of the readings of a thermistor.
+ *
+ * With CONFIG_THERMISTOR_STATS each handle counts its bursts, the failed 
+ * conversions of the ADC, the readings without calibration and the misses 
+ * of the NVS cache, and keeps 
+ * the minimum, maximum and a log2 histogram of the time of the bursts and of 
+ * the cycles of the conversions (see thermistor_get_stats()).
+ *
+ * This module does not depend on the ESP-IDF.
+ */
+
+#ifndef __THERMISTOR_STATS_H__
+#define __THERMISTOR_STATS_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define THERMISTOR_STATS_BINS   16  /**< Bins of a histogram, the last one counts the values from 2^15. */
+
+/**
+ * @brief Histogram of a latency.
+ *
+ * Bin i counts the values in [2^i, 2^(i+1)), the bin 0 also counts the zeros.
+ */
+typedef struct
+{
+    uint32_t count;                 /**< Number of values. */
+    uint32_t min;                   /**< Smallest value, UINT32_MAX without values. */
+    uint32_t max;                   /**< Largest value. */
+    uint32_t bins[THERMISTOR_STATS_BINS]; /**< Number of values of each power of two. */
+} thermistor_histogram_t;
+
+/**
+ * @brief Counters of a thermistor.
+ */
+typedef struct
+{
+    uint32_t reads;                 /**< Bursts of conversions of the channel. */
+    uint32_t read_errors;           /**< Bursts that failed, their reading has vout 0. */
+    int32_t last_error;             /**< esp_err_t of the last failed burst. */
+    uint32_t cali_fallbacks;        /**< Readings converted without the calibration scheme (vout 0), in any configuration. */
+    uint32_t nvs_misses;            /**< Inits that found no calibration in NVS, 0 or 1, always 0 without CONFIG_THERMISTOR_NVS_CACHE. */
+    thermistor_histogram_t burst_us;        /**< Time of the bursts in us, with the settling of the divider. */
+    thermistor_histogram_t convert_cycles;  /**< CPU cycles of the conversion of the averaged raw codes. */
+} thermistor_stats_t;
+
+/**
+ * @brief Clear a histogram.
+ *
+ * @param   hist  Pointer of the histogram.
+ */
+static inline void thermistor_histogram_reset(thermistor_histogram_t* hist)
+{
+    hist->count = 0;
+    hist->min = UINT32_MAX;
+    hist->max = 0;
+    for (uint32_t i = 0; i < THERMISTOR_STATS_BINS; i++) {
+        hist->bins[i] = 0;
+    }
+}
+
+/**
+ * @brief Add a value to a histogram.
+ *
+ * @param   hist  Pointer of the histogram.
+ * @param   value  Latency to add.
+ */
+static inline void thermistor_histogram_add(thermistor_histogram_t* hist, uint32_t value)
+{
+    uint32_t bin = (value > 1) ? (31 - __builtin_clz(value)) : 0;
+
+    if (bin >= THERMISTOR_STATS_BINS) {
+        bin = THERMISTOR_STATS_BINS - 1;
+    }
+
+    hist->bins[bin]++;
+    hist->count++;
+    if (value < hist->min) {
+        hist->min = value;
+    }
+    if (value > hist->max) {
+        hist->max = value;
+    }
+}
+
+/**
+ * @brief Clear all the counters.
+ *
+ * @param   stats  Pointer of the counters.
+ */
+static inline void thermistor_stats_reset(thermistor_stats_t* stats)
+{
+    stats->reads = 0;
+    stats->read_errors = 0;
+    stats->last_error = 0;
+    stats->cali_fallbacks = 0;
+    stats->nvs_misses = 0;
+    thermistor_histogram_reset(&stats->burst_us);
+    thermistor_histogram_reset(&stats->convert_cycles);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __THERMISTOR_STATS_H__ */
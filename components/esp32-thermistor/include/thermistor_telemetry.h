@@ -0,0 +1,153 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_telemetry.h
+ * @brief Compact binary records to stream the readings without printf.
+ *
+ * Each reading is encoded in a record that starts with a header byte:
+ *
+ * - Key record (7 bytes): header 0x80 | (seq & 0x7F), sequence (uint16 LE), 
+ *   raw code (uint16 LE) and temperature in hundredths of degree (int16 LE).
+ * - Delta record (4 bytes for changes up to 0.63 C): header (seq & 0x7F), raw 
+ *   code (uint16 LE) and the difference with the previous temperature as a 
+ *   zigzag varint.
+ *
+ * Each record is framed with COBS (Consistent Overhead Byte Stuffing) and ends 
+ * with a 0x00 delimiter, which never appears inside a frame: one byte more for 
+ * the COBS code and one for the delimiter (6 bytes for a small delta record, 
+ * 9 bytes for a key record). A decoder that joins the stream, or that gets 
+ * corrupted bytes, drops the data up to the next delimiter. A key record is 
+ * sent every key_interval records, so the decoder can restore the temperature 
+ * from the next one, and the low bits of the sequence detect lost records 
+ * (the decoder waits for the next key record). The frames can be sent over 
+ * UART, USB-CDC or MQTT as they are, but a channel shared with text (like the 
+ * console) can produce frames that look valid, so prefer a dedicated one.
+ *
+ * This module does not depend on the ESP-IDF.
+ */
+
+#ifndef __THERMISTOR_TELEMETRY_H__
+#define __THERMISTOR_TELEMETRY_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define THERMISTOR_TELEMETRY_MAX_RECORD     9       /**< Maximum size of a framed record in bytes. */
+
+/**
+ * @brief Decoded reading.
+ */
+typedef struct
+{
+    uint16_t seq;                   /**< Sequence number of the record. */
+    uint16_t raw;                   /**< Averaged raw code. */
+    int16_t centi_celsius;          /**< Temperature in hundredths of degrees Celsius. */
+} thermistor_telemetry_record_t;
+
+/**
+ * @brief State of the encoder.
+ *
+ * @note Call thermistor_telemetry_encoder_init() to initialize the structure
+ */
+typedef struct
+{
+    uint16_t seq;                   /**< Sequence number of the next record. */
+    uint16_t key_interval;          /**< Records between key records. */
+    uint16_t since_key;             /**< Records since the last key record. */
+    int16_t last_centi;             /**< Temperature of the previous record. */
+} thermistor_telemetry_encoder_t;
+
+/**
+ * @brief State of the decoder.
+ *
+ * @note Call thermistor_telemetry_decoder_init() to initialize the structure
+ */
+typedef struct
+{
+    bool synced;                    /**< A key record was received and no record was lost. */
+    uint16_t seq;                   /**< Sequence number of the last record. */
+    int16_t last_centi;             /**< Temperature of the last record. */
+    uint32_t lost;                  /**< Number of records detected as lost. */
+} thermistor_telemetry_decoder_t;
+
+/**
+ * @brief Initialize the encoder, the first record is a key record.
+ *
+ * @param   enc  Pointer of the encoder.
+ * @param   key_interval Records between key records, 0 or 1 sends only key records.
+ */
+void thermistor_telemetry_encoder_init(thermistor_telemetry_encoder_t* enc, uint16_t key_interval);
+
+/**
+ * @brief Encode a reading in a framed record, with its delimiter.
+ *
+ * @param   enc  Pointer of the encoder.
+ * @param   raw  Averaged raw code.
+ * @param   centi_celsius  Temperature in hundredths of degrees Celsius.
+ * @param   buf  Buffer where the record is written.
+ * @param   len  Free space of buf, THERMISTOR_TELEMETRY_MAX_RECORD is always enough.
+ *
+ * @return
+ *      - Size of the frame, or 0 if it does not fit (the encoder is not modified).
+ */
+size_t thermistor_telemetry_encode(thermistor_telemetry_encoder_t* enc, uint16_t raw, 
+                                   int16_t centi_celsius, uint8_t* buf, size_t len);
+
+/**
+ * @brief Initialize the decoder, it waits for a key record.
+ *
+ * @param   dec  Pointer of the decoder.
+ */
+void thermistor_telemetry_decoder_init(thermistor_telemetry_decoder_t* dec);
+
+/**
+ * @brief Decode the next framed record of a buffer.
+ *
+ * Call it again with the bytes after the returned size (its absolute value 
+ * when it is negative) until it returns 0.
+ *
+ * @param   dec  Pointer of the decoder.
+ * @param   buf  Received bytes.
+ * @param   len  Number of received bytes.
+ * @param   out  Pointer to store the reading.
+ *
+ * @return
+ *      - > 0: Bytes of the frame, out is valid.
+ *      - 0: The frame is incomplete, wait for more bytes.
+ *      - < 0: Bytes skipped, of a corrupted frame or while waiting for a key record, out is not valid.
+ */
+int thermistor_telemetry_decode(thermistor_telemetry_decoder_t* dec, const uint8_t* buf, 
+                                size_t len, thermistor_telemetry_record_t* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __THERMISTOR_TELEMETRY_H__ */
@@ -0,0 +1,108 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_ulp.h
+ * @brief Sampling of a thermistor by the ULP coprocessor during the deep sleep.
+ *
+ * The ULP averages a burst of conversions of the channel at a fixed period, 
+ * stores the raw code in the RTC slow memory and wakes up the main CPU when 
+ * the temperature leaves the configured range, or when the batch is full. The 
+ * thresholds are converted to raw codes before sleeping, so the ULP program 
+ * only compares integers. The ULP does not measure the excitation rail, the 
+ * codes are converted with the rail of the last reading of the handle (the 
+ * nominal vsource if it is not measured).
+ *
+ * @note Only the FSM ULP of the ESP32 is supported (CONFIG_ULP_COPROC_TYPE_FSM),
+ * on other targets the functions return ESP_ERR_NOT_SUPPORTED.
+ */
+
+#ifndef __THERMISTOR_ULP_H__
+#define __THERMISTOR_ULP_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "thermistor.h"
+
+#include "sdkconfig.h"
+
+#ifndef CONFIG_THERMISTOR_ULP_MAX_BATCH
+#define CONFIG_THERMISTOR_ULP_MAX_BATCH 32
+#endif
+
+#define THERMISTOR_ULP_MAX_BATCH    CONFIG_THERMISTOR_ULP_MAX_BATCH /**< Maximum number of samples stored by the ULP. */
+
+/**
+ * @brief Configuration of the ULP sampling.
+ */
+typedef struct
+{
+    float low_celsius;              /**< Wake up when the temperature falls below. */
+    float high_celsius;             /**< Wake up when the temperature rises above. */
+    uint32_t period_ms;             /**< Period of the samples. */
+    uint16_t batch;                 /**< Wake up after this number of samples, from 1 to THERMISTOR_ULP_MAX_BATCH. */
+} thermistor_ulp_config_t;
+
+/**
+ * @brief Load and start the ULP program that samples the thermistor.
+ *
+ * Call it just before esp_deep_sleep_start(), the ULP wake up source is enabled.
+ * The channel is released from the driver because the ULP owns the ADC1 
+ * during the sleep, so the handle must be initialized again to read it. It 
+ * must be the only channel of the ADC1, and if the ULP fails to start it is 
+ * registered again.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   config Thresholds and period of the samples.
+ *
+ * @return
+ *      - ESP_OK: The ULP is running.
+ *      - ESP_ERR_INVALID_ARG: The configuration is not valid.
+ *      - ESP_ERR_INVALID_STATE: The ADC is not calibrated or it is used by other thermistors, 
+ *        the handle is sampling, or the range selection is enabled.
+ *      - ESP_ERR_NO_MEM: CONFIG_ULP_COPROC_RESERVE_MEM is too small for the batch.
+ *      - ESP_ERR_NOT_SUPPORTED: The target has no FSM ULP.
+ */
+esp_err_t thermistor_ulp_start(thermistor_handle_t* th, const thermistor_ulp_config_t* config);
+
+/**
+ * @brief Get the raw codes stored by the ULP, and clear them.
+ *
+ * Convert the samples with thermistor_raw_to_celsius().
+ *
+ * @param   raw Array to store the raw codes, oldest first.
+ * @param   max Length of the array.
+ *
+ * @return
+ *      - Number of raw codes copied.
+ */
+size_t thermistor_ulp_get_samples(uint16_t* raw, size_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __THERMISTOR_ULP_H__ */
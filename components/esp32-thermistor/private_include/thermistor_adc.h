@@ -0,0 +1,188 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_adc.h
+ * @brief Private definitions of the ADC unit manager shared by the thermistors.
+ *
+ * The IDF allows only one oneshot (or continuous) handle per ADC unit, so the 
+ * unit is created by the first thermistor and reference counted by the rest.
+ * The calibration schemes are cached by attenuation in the same way, and all 
+ * the registered channels can be sampled in one interleaved scan.
+ *
+ * The conversions are serialized by a mutex of the unit, since the oneshot 
+ * driver fails with ESP_ERR_TIMEOUT instead of waiting when another task (or 
+ * the other core) is using the ADC. The same mutex is taken to register and 
+ * release the channels and the calibration schemes, so the thermistors can be 
+ * initialized from any task.
+ */
+
+#ifndef __THERMISTOR_ADC_H__
+#define __THERMISTOR_ADC_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_continuous.h"
+
+/**
+ * @brief Average the sum of a burst of samples.
+ *
+ * Power of two bursts are averaged with a shift instead of a division.
+ */
+static inline uint32_t thermistor_adc_average(uint32_t sum, uint32_t samples)
+{
+    if ((samples & (samples - 1)) == 0) {
+        return sum >> __builtin_ctz(samples);
+    }
+
+    return sum / samples;
+}
+
+/**
+ * @brief Register a channel in the shared ADC1 unit.
+ *
+ * The first call creates the unit, later calls only configure the channel. 
+ * In continuous mode the conversion pattern is rebuilt with all the registered 
+ * channels.
+ *
+ * @param   channel ADC channel pin where the thermistor is connected.
+ * @param   atten Attenuation of the channel.
+ * @param   out_oneshot Pointer to store the oneshot handle (NULL in continuous mode).
+ * @param   out_cont Pointer to store the continuous handle (NULL in oneshot mode).
+ *
+ * @return
+ *      - ESP_OK: The channel is ready to be read.
+ *      - ESP_ERR_INVALID_STATE: The channel is already registered.
+ */
+esp_err_t thermistor_adc_add_channel(adc_channel_t channel, adc_atten_t atten,
+                                     adc_oneshot_unit_handle_t* out_oneshot,
+                                     adc_continuous_handle_t* out_cont);
+
+/**
+ * @brief Register a channel that several thermistors read, like the reference 
+ *        of the excitation rail.
+ *
+ * @param   channel ADC channel to read.
+ * @param   atten Attenuation of the channel, the same for all the users.
+ *
+ * @return
+ *      - ESP_OK: The channel is ready to be read.
+ *      - ESP_ERR_INVALID_STATE: The channel is in use as a thermistor, or with other attenuation.
+ */
+esp_err_t thermistor_adc_add_shared_channel(adc_channel_t channel, adc_atten_t atten);
+
+/**
+ * @brief Unregister a channel, the unit is deleted with the last one.
+ *
+ * A shared channel is only unregistered by its last user.
+ *
+ * @param   channel ADC channel registered with thermistor_adc_add_channel().
+ *
+ * @return
+ *      - ESP_OK: The channel was released.
+ */
+esp_err_t thermistor_adc_remove_channel(adc_channel_t channel);
+
+/**
+ * @brief Check if a channel is the only user of the ADC1 unit.
+ *
+ * @param   channel ADC channel registered with thermistor_adc_add_channel().
+ *
+ * @return
+ *      - true: No other channel is registered, and the channel is not shared.
+ */
+bool thermistor_adc_is_exclusive(adc_channel_t channel);
+
+/**
+ * @brief Change the attenuation of a registered channel, in oneshot mode.
+ *
+ * @param   channel ADC channel registered with thermistor_adc_add_channel().
+ * @param   atten New attenuation of the channel.
+ *
+ * @return
+ *      - ESP_OK: The next conversions of the channel use the attenuation.
+ *      - ESP_ERR_NOT_FOUND: The channel is not registered.
+ *      - ESP_ERR_INVALID_STATE: The channel is shared.
+ *      - ESP_ERR_NOT_SUPPORTED: The unit is in continuous mode.
+ */
+esp_err_t thermistor_adc_set_atten(adc_channel_t channel, adc_atten_t atten);
+
+/**
+ * @brief Get the calibration scheme of an attenuation, created on first use.
+ *
+ * @param   atten Attenuation of the channel.
+ * @param   out_handle Pointer to store the calibration handle.
+ *
+ * @return
+ *      - true: The calibration is available.
+ */
+bool thermistor_adc_get_calibration(adc_atten_t atten, adc_cali_handle_t* out_handle);
+
+/**
+ * @brief Release a calibration scheme obtained with thermistor_adc_get_calibration().
+ *
+ * @param   atten Attenuation of the channel.
+ */
+void thermistor_adc_put_calibration(adc_atten_t atten);
+
+/**
+ * @brief Take the ADC unit for a burst of conversions.
+ *
+ * The mutex is created by the first call, it is also taken by the registration 
+ * functions, so do not call them with the unit locked.
+ */
+void thermistor_adc_lock(void);
+
+/**
+ * @brief Release the ADC unit taken with thermistor_adc_lock().
+ */
+void thermistor_adc_unlock(void);
+
+/**
+ * @brief Average several registered channels in one interleaved pass.
+ *
+ * In oneshot mode the conversions alternate between the channels, and in
+ * continuous mode the channels are taken from the same DMA frames.
+ * The unit is locked during the whole pass.
+ *
+ * @param   channels Array of registered channels.
+ * @param   count Number of channels.
+ * @param   samples Amount of conversions to average per channel.
+ * @param   out_raw Array of count elements to store the averaged raw codes.
+ *
+ * @return
+ *      - ESP_OK: All the raw codes are valid.
+ */
+esp_err_t thermistor_adc_scan(const adc_channel_t* channels, size_t count, 
+                              uint32_t samples, int* out_raw);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __THERMISTOR_ADC_H__ */
@@ -0,0 +1,84 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_alloc.h
+ * @brief Private allocator of the tables of the thermistor driver.
+ *
+ * By default the blocks come from the heap. With CONFIG_THERMISTOR_STATIC_ALLOCATION 
+ * they are taken from a static arena of CONFIG_THERMISTOR_ARENA_SIZE bytes: 
+ * the tables of the handles grow from the bottom, and the scratch buffers 
+ * used while loading or saving the calibration from the top. Both sides 
+ * are stacks, the memory of a block is recovered when it is freed and all 
+ * the blocks above it are free too.
+ *
+ * @note The allocator is not thread-safe. It is only used by the init and 
+ * deinit functions and by the start and stop of the driver tasks, which the 
+ * application must not call concurrently; the readings never allocate.
+ */
+
+#ifndef __THERMISTOR_ALLOC_H__
+#define __THERMISTOR_ALLOC_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+/**
+ * @brief Allocate a block that lives until thermistor_deinit(), or until the stop of a task.
+ *
+ * @param   size Bytes of the block.
+ *
+ * @return
+ *      - Pointer aligned to 8 bytes, or NULL if there is no memory.
+ */
+void* thermistor_alloc(size_t size);
+
+/**
+ * @brief Free a block of thermistor_alloc(), NULL is ignored.
+ */
+void thermistor_free(void* ptr);
+
+/**
+ * @brief Allocate a temporary buffer, freed before the init function returns.
+ *
+ * @param   size Bytes of the buffer.
+ *
+ * @return
+ *      - Pointer aligned to 8 bytes, or NULL if there is no memory.
+ */
+void* thermistor_scratch_alloc(size_t size);
+
+/**
+ * @brief Free a buffer of thermistor_scratch_alloc(), NULL is ignored.
+ */
+void thermistor_scratch_free(void* ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __THERMISTOR_ALLOC_H__ */
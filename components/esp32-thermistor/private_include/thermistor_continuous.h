@@ -0,0 +1,93 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_continuous.h
+ * @brief Private definitions of the continuous (DMA) ADC backend.
+ *
+ * In this mode the ADC converts in the background at a fixed rate and the 
+ * driver stores the results in a DMA ring buffer, so a reading only has to 
+ * collect and average the frames that are already converted.
+ */
+
+#ifndef __THERMISTOR_CONTINUOUS_H__
+#define __THERMISTOR_CONTINUOUS_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_adc/adc_continuous.h"
+
+/**
+ * @brief Create the continuous driver of ADC1.
+ *
+ * @param   out_handle Pointer to store the continuous driver handle.
+ *
+ * @return
+ *      - ESP_OK: The driver was created.
+ */
+esp_err_t thermistor_continuous_new(adc_continuous_handle_t* out_handle);
+
+/**
+ * @brief Configure the conversion pattern and start the conversions.
+ *
+ * The driver has to be stopped to change the pattern.
+ *
+ * @param   handle Continuous driver handle.
+ * @param   channels Array of channels to convert.
+ * @param   attens Attenuation of each channel.
+ * @param   count Number of channels, up to SOC_ADC_PATT_LEN_MAX.
+ *
+ * @return
+ *      - ESP_OK: The conversions are running.
+ */
+esp_err_t thermistor_continuous_start(adc_continuous_handle_t handle, const adc_channel_t* channels,
+                                      const adc_atten_t* attens, size_t count);
+
+/**
+ * @brief Average the next conversions of the channels stored by the DMA.
+ *
+ * The pool is flushed first so the result represents the current voltage and
+ * not the frames accumulated since the previous reading. The calling task 
+ * blocks (without using the CPU) until the frames are ready.
+ *
+ * @param   handle Continuous driver handle.
+ * @param   channels Array of channels to average.
+ * @param   count Number of channels.
+ * @param   samples Amount of conversions to average per channel.
+ * @param   out_raw Array of count elements to store the averaged raw codes.
+ *
+ * @return
+ *      - ESP_OK: The raw codes are valid.
+ *      - ESP_ERR_TIMEOUT: The DMA did not deliver the frames in time.
+ */
+esp_err_t thermistor_continuous_read_raw(adc_continuous_handle_t handle, const adc_channel_t* channels, 
+                                         size_t count, uint32_t samples, int* out_raw);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __THERMISTOR_CONTINUOUS_H__ */
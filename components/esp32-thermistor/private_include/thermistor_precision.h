@@ -0,0 +1,50 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_precision.h
+ * @brief Private selection of the arithmetic used by the conversions.
+ *
+ * Without a double FPU the double operations are emulated by libgcc, so the 
+ * single precision path keeps the conversion in float (hardware on ESP32/S3).
+ */
+
+#ifndef __THERMISTOR_PRECISION_H__
+#define __THERMISTOR_PRECISION_H__
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+#include <math.h>
+
+#if CONFIG_THERMISTOR_MATH_FLOAT
+#define MATH_LOG(x)     logf(x)
+#define MATH_CONST(x)   (x##f)
+#else
+#define MATH_LOG(x)     log(x)
+#define MATH_CONST(x)   (x)
+#endif
+
+#endif /* __THERMISTOR_PRECISION_H__ */
@@ -0,0 +1,214 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_priv.h
+ * @brief Private functions shared by the modules of thermistor component.
+ */
+
+#ifndef __THERMISTOR_PRIV_H__
+#define __THERMISTOR_PRIV_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "thermistor.h"
+
+#define THERMISTOR_CALI_SHIFT   5   /**< Log2 of the step in raw codes between the entries of cali_table. */
+#define THERMISTOR_CALI_SIZE    (((1 << SOC_ADC_RTC_MAX_BITWIDTH) >> THERMISTOR_CALI_SHIFT) + 1)
+
+#define THERMISTOR_TASK_STOP    (1u << 31)  /**< Notification bit that asks a driver task to exit. */
+
+#define THERMISTOR_SAMPLING_EXITED  (1 << 0)    /**< Exit bit of the sampling task in task_events. */
+#define THERMISTOR_ACQUISITION_EXITED (1 << 1)  /**< Exit bit of the acquisition task of the pipeline. */
+#define THERMISTOR_PROCESSING_EXITED (1 << 2)   /**< Exit bit of the processing task of the pipeline. */
+
+#ifndef CONFIG_THERMISTOR_TASK_STACK_SIZE
+#define CONFIG_THERMISTOR_TASK_STACK_SIZE 3072
+#endif
+
+#ifndef CONFIG_THERMISTOR_TASK_PRIORITY
+#define CONFIG_THERMISTOR_TASK_PRIORITY 5
+#endif
+
+/**
+ * @brief Stack and TCB of a driver task created by thermistor_task_create().
+ */
+struct thermistor_task_storage
+{
+    StaticTask_t tcb;
+    StackType_t stack[CONFIG_THERMISTOR_TASK_STACK_SIZE];
+};
+
+/**
+ * @brief Convert a vout to a reading without modifying the handle.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   vout Output voltage of the resistive divider in mV.
+ * @param   reading Pointer to store the vout, resistance and temperature.
+ */
+void thermistor_fill_reading(const thermistor_handle_t* th, uint32_t vout, 
+                             thermistor_reading_t* reading);
+
+/**
+ * @brief Perform a timestamped reading, which is also stored in the ring of the handle.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   reading Pointer to store the reading.
+ *
+ * @return
+ *      - ESP_OK: The reading is valid.
+ *      - ESP_ERR_INVALID_RESPONSE: The thermistor has a fault.
+ */
+esp_err_t thermistor_acquire(thermistor_handle_t* th, thermistor_reading_t* reading);
+
+/**
+ * @brief Average a burst of the thermistor and of its reference channel, without processing it.
+ *
+ * The divider is powered during the burst. The handle is only written by the
+ * counters of CONFIG_THERMISTOR_STATS, so the burst can run in another task 
+ * than thermistor_process_raw().
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   adc_raw Array of 2 elements to store the raw codes of the thermistor and the reference.
+ *
+ * @return
+ *      - ESP_OK: The raw codes are valid.
+ */
+esp_err_t thermistor_burst_raw(thermistor_handle_t* th, int* adc_raw);
+
+/**
+ * @brief Filter and convert the raw codes of thermistor_burst_raw(), as thermistor_acquire().
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   adc_raw Raw codes of the thermistor and the reference.
+ * @param   reading Pointer of the reading, with the timestamp of the burst.
+ *
+ * @return
+ *      - ESP_OK: The reading is valid.
+ *      - ESP_ERR_INVALID_RESPONSE: The thermistor has a fault.
+ */
+esp_err_t thermistor_process_raw(thermistor_handle_t* th, const int* adc_raw, thermistor_reading_t* reading);
+
+/**
+ * @brief Publish a reading for thermistor_get_latest().
+ *
+ * @note There must be only one writer at a time for each handle.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   reading Reading to publish.
+ */
+void thermistor_publish(thermistor_handle_t* th, const thermistor_reading_t* reading);
+
+/**
+ * @brief Create the periodic timer of the handle, only on the first call.
+ *
+ * The timer notifies th->sampling_task on each period with an increment,
+ * it is kept until thermistor_deinit().
+ *
+ * @param   th  Pointer of the driver information.
+ *
+ * @return
+ *      - ESP_OK: The timer exists.
+ *      - Others: Error of esp_timer_create().
+ */
+esp_err_t thermistor_timer_init(thermistor_handle_t* th);
+
+/**
+ * @brief Create a driver task, statically in storage with CONFIG_THERMISTOR_STATIC_ALLOCATION.
+ *
+ * @param   function Function of the task, it must end with thermistor_task_exit().
+ * @param   name Name of the task.
+ * @param   arg Argument of the function.
+ * @param   core Core of the task, or tskNO_AFFINITY.
+ * @param   storage Stack and TCB of the task, not used when the task is created in the heap.
+ * @param   task Pointer to store the handle of the task.
+ *
+ * @return
+ *      - ESP_OK: The task is running.
+ *      - ESP_ERR_NO_MEM: There is no memory for the task.
+ */
+esp_err_t thermistor_task_create(TaskFunction_t function, const char* name, void* arg, BaseType_t core,
+                                 thermistor_task_storage_t* storage, TaskHandle_t* task);
+
+/**
+ * @brief Signal the exit of a driver task to thermistor_task_join(), and wait to be deleted.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   bit Exit bit of the task in task_events.
+ */
+void thermistor_task_exit(thermistor_handle_t* th, EventBits_t bit);
+
+/**
+ * @brief Ask a driver task to exit with THERMISTOR_TASK_STOP, wait for it and delete it.
+ *
+ * The stop is the last notification that the caller sends to the task, and 
+ * the join does not use the notifications of the calling task.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   task Task to stop, it must end with thermistor_task_exit().
+ * @param   bit Exit bit of the task in task_events.
+ */
+void thermistor_task_join(thermistor_handle_t* th, TaskHandle_t task, EventBits_t bit);
+
+/**
+ * @brief Build the lookup table of the thermistor, and reserve its spare table.
+ *
+ * @param   th  Pointer of the driver information.
+ *
+ * @return
+ *      - ESP_OK: The table is ready.
+ *      - ESP_ERR_NO_MEM: There is no memory for the table.
+ */
+esp_err_t thermistor_lut_build(thermistor_handle_t* th);
+
+/**
+ * @brief Reserve the active and the spare lookup tables in one block, and select the active one.
+ *
+ * @param   th  Pointer of the driver information.
+ * @param   size Entries of each table.
+ * @param   shift Log2 of the step in mV of the active table.
+ *
+ * @return
+ *      - Entries of the active table to fill, or NULL if there is no memory.
+ */
+int16_t* thermistor_lut_reserve(thermistor_handle_t* th, uint16_t size, uint8_t shift);
+
+/**
+ * @brief Load the calibration and the lookup table stored by thermistor_save_calibration().
+ *
+ * @param   th  Pointer of the driver information, with the parameters of the thermistor.
+ *
+ * @return
+ *      - ESP_OK: cali_table, the correction and the lookup table were loaded.
+ *      - ESP_ERR_NOT_FOUND: There is no valid calibration for these parameters.
+ */
+esp_err_t thermistor_nvs_load(thermistor_handle_t* th);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __THERMISTOR_PRIV_H__ */
@@ -0,0 +1,134 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_spsc.h
+ * @brief Lock-free queue between one producer and one consumer.
+ *
+ * The producer only writes head and the consumer only writes tail, so the 
+ * queue needs no lock or critical section when each side runs on a 
+ * different core. The indexes are free running and the capacity is a power 
+ * of two, so the count is head - tail even after they wrap.
+ * This module does not depend on the ESP-IDF.
+ */
+
+#ifndef __THERMISTOR_SPSC_H__
+#define __THERMISTOR_SPSC_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Raw codes of one burst, as queued by the acquisition task.
+ */
+typedef struct
+{
+    int64_t timestamp_us;           /**< Time of the burst from esp_timer_get_time(). */
+    uint16_t raw[2];                /**< Averaged raw codes of the thermistor and of the reference channel. */
+} thermistor_spsc_item_t;
+
+/**
+ * @brief Structure to storing the queue.
+ * @note Call thermistor_spsc_init() to initialize the structure
+ */
+typedef struct
+{
+    thermistor_spsc_item_t* buffer; /**< Storage of capacity items. */
+    uint32_t mask;                  /**< Capacity - 1. */
+    uint32_t head;                  /**< Items pushed, written by the producer. */
+    uint32_t tail;                  /**< Items popped, written by the consumer. */
+} thermistor_spsc_t;
+
+/**
+ * @brief Initialize an empty queue.
+ *
+ * @param   q  Pointer of the queue.
+ * @param   buffer  Storage of the items.
+ * @param   capacity  Number of items of the buffer, a power of two.
+ */
+static inline void thermistor_spsc_init(thermistor_spsc_t* q, thermistor_spsc_item_t* buffer, uint32_t capacity)
+{
+    q->buffer = buffer;
+    q->mask = capacity - 1;
+    q->head = 0;
+    q->tail = 0;
+}
+
+/**
+ * @brief Add an item, only from the producer.
+ *
+ * @return
+ *      - true: The item was queued, false if the queue is full.
+ */
+static inline bool thermistor_spsc_push(thermistor_spsc_t* q, const thermistor_spsc_item_t* item)
+{
+    uint32_t head = q->head;
+
+    if ((head - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE)) > q->mask) {
+        return false;
+    }
+
+    q->buffer[head & q->mask] = *item;
+    __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+/**
+ * @brief Remove the oldest item, only from the consumer.
+ *
+ * @return
+ *      - true: The item was copied, false if the queue is empty.
+ */
+static inline bool thermistor_spsc_pop(thermistor_spsc_t* q, thermistor_spsc_item_t* item)
+{
+    uint32_t tail = q->tail;
+
+    if (tail == __atomic_load_n(&q->head, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+
+    *item = q->buffer[tail & q->mask];
+    __atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+/**
+ * @brief Number of queued items, exact from either side.
+ */
+static inline uint32_t thermistor_spsc_count(const thermistor_spsc_t* q)
+{
+    return __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __THERMISTOR_SPSC_H__ */
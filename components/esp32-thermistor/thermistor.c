@@ -28,75 +28,505 @@
  */
 
 #include "thermistor.h"
+#include "thermistor_adc.h"
+#include "thermistor_alloc.h"
+#include "thermistor_priv.h"
+#include "thermistor_precision.h"
 
 #include "math.h"
+#include <stdlib.h>
+
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+#include "esp_cpu.h"
+#include "driver/gpio.h"
+
+#include "sdkconfig.h"
+
+#if CONFIG_THERMISTOR_LUT_ROM
+#include "thermistor_lut_rom.h"
+#endif
 
 #include "esp_log.h"
 static const char* TAG = "drv_thr";
 
 #define DEFAULT_VREF    1100        // Use adc2_vref_to_gpio() to obtain a better estimate
-#define NO_OF_SAMPLES   64          // Amount suggested by espresif for multiple samples.
 
-static bool adc_calibration_init(adc_unit_t unit, adc_atten_t atten, adc_cali_handle_t *out_handle);
+#ifndef CONFIG_THERMISTOR_OVERSAMPLING
+#define CONFIG_THERMISTOR_OVERSAMPLING 64   // Amount suggested by espresif for multiple samples.
+#endif
+
+#ifndef CONFIG_THERMISTOR_LUT_STEP_SHIFT
+#define CONFIG_THERMISTOR_LUT_STEP_SHIFT 4
+#endif
+
+#define PARAMS_DIVIDER      (1 << 0)    // serial_resistance and vsource.
+#define PARAMS_BETA         (1 << 1)    // Beta model, also changes the coefficients.
+
+#define RAIL_TOLERANCE_DIV  1024    // Drift of the measured rail that converts the alarms again.
+
+#define RANGE_FULL_CODE     ((1 << ADC_BITWIDTH_12) - 1)
+#define RANGE_SATURATED     (RANGE_FULL_CODE - 16)  // Codes this close to the end of a range may have clipped.
+
+/**
+ * @brief End in mV of the usable range of each attenuation, valid for all the targets.
+ */
+static const uint16_t s_range_max_mv[ADC_ATTEN_DB_12 + 1] = { 750, 1050, 1300, 2450 };
 
 esp_err_t thermistor_init(thermistor_handle_t* th,
                           adc_channel_t channel, float serial_resistance, 
                           float nominal_resistance, float nominal_temperature, 
                           float beta_val, float vsource)
 {
-    adc_oneshot_unit_handle_t adc_handle;
-    adc_oneshot_unit_init_cfg_t init_config = {
-        .unit_id = ADC_UNIT_1,
+    thermistor_model_config_t model = {
+        .model = THERMISTOR_MODEL_BETA,
+        .beta = {
+            .nominal_resistance = nominal_resistance,
+            .nominal_temperature = nominal_temperature,
+            .beta_val = beta_val,
+        },
     };
 
-    esp_err_t err = adc_oneshot_new_unit(&init_config, &adc_handle);
-    
-    if (err == ESP_OK) {
-        adc_oneshot_chan_cfg_t config = {
-                    .bitwidth = ADC_BITWIDTH_12, 
-                    .atten = ADC_ATTEN_DB_12,
-        };
-        
-        err = adc_oneshot_config_channel(adc_handle, channel, &config);
+    return thermistor_init_model(th, channel, serial_resistance, vsource, &model);
+}
+
+esp_err_t thermistor_init_model(thermistor_handle_t* th,
+                                adc_channel_t channel, float serial_resistance, 
+                                float vsource, const thermistor_model_config_t* model)
+{
+    adc_oneshot_unit_handle_t adc_handle = NULL;
+    adc_continuous_handle_t adc_cont_handle = NULL;
+
+    if (!thermistor_model_prepare(&th->coeffs_buffer[0], model)) {
+        ESP_LOGE(TAG, "invalid model configuration");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // The unit is shared by all the thermistors, each one only adds its channel.
+    esp_err_t err = thermistor_adc_add_channel(channel, ADC_ATTEN_DB_12, 
+                                               &adc_handle, &adc_cont_handle);
 
-        adc_cali_handle_t adc_cali_handle = NULL;
-        th->calibrated = adc_calibration_init(ADC_UNIT_1, ADC_ATTEN_DB_12, &adc_cali_handle);
+    if (err == ESP_OK) {
         th->channel = channel;
         th->adc_h = adc_handle;
-        th->adc_cali_h = adc_cali_handle;
+        th->adc_cont_h = adc_cont_handle;
+        th->adc_cali_h = NULL;
+        th->cali_table = NULL;
+        th->cali_gain = 1.0f;
+        th->cali_offset_mv = 0;
+        th->coeffs = &th->coeffs_buffer[0];
+        th->lut = NULL;
+        for (uint32_t i = 0; i < 2; i++) {
+            th->lut_buffer[i].table = NULL;
+            th->lut_buffer[i].capacity = 0;
+            th->lut_buffer[i].owned = false;
+        }
         th->serial_resistance = serial_resistance; 
-        th->nominal_resistance = nominal_resistance;
-        th->nominal_temperature = nominal_temperature;
-        th->beta_val = beta_val;
+        th->nominal_resistance = 0;
+        th->nominal_temperature = 0;
+        th->beta_val = 0;
         th->vsource = vsource;
         th->t_resistance = 0;
+        th->samples = CONFIG_THERMISTOR_OVERSAMPLING;
+        thermistor_filter_init(&th->filter, NULL);
+        thermistor_alarm_disable(&th->alarm);
+        th->alarm_config.high_celsius = INFINITY;
+        th->alarm_config.low_celsius = -INFINITY;
+        th->alarm_config.hysteresis = 0;
+        portMUX_INITIALIZE(&th->params.lock);
+        th->params.pending = 0;
+        th->params_seq = 0;
+        th->excitation.gpio = GPIO_NUM_NC;
+        th->excitation.measure_vsource = false;
+        th->excitation.vsource_mv = 0;
+        th->excitation.alarm_rail = 0;
+        th->ratiometric = false;
+        th->full_scale_raw = 0;
+        th->ring = NULL;
+        th->sampling_task = NULL;
+        th->sampling_storage = NULL;
+        th->task_events = NULL;
+        th->sampling_timer = NULL;
+        th->latest_seq = 0;
+        th->pipeline = NULL;
+        th->adaptive.enabled = false;
+        th->range.enabled = false;
+        th->range.atten = ADC_ATTEN_DB_12;
+        th->fault_short_raw = THERMISTOR_FAULT_MARGIN;
+        th->fault_open_raw = RANGE_FULL_CODE - THERMISTOR_FAULT_MARGIN;
+        th->fault = THERMISTOR_FAULT_NONE;
+        th->fault_skips = 0;
+        th->async_pending = false;
+#if CONFIG_THERMISTOR_STATS
+        thermistor_stats_reset(&th->stats);
+#endif
+
+        if (model->model == THERMISTOR_MODEL_BETA) {
+            th->nominal_resistance = model->beta.nominal_resistance;
+            th->nominal_temperature = model->beta.nominal_temperature;
+            th->beta_val = model->beta.beta_val;
+        }
+
+#if CONFIG_THERMISTOR_NVS_CACHE
+        // A stored calibration avoids the creation of the scheme and the table.
+        if (thermistor_nvs_load(th) == ESP_OK) {
+            th->calibrated = true;
+            return ESP_OK;
+        }
+#endif
+
+#if CONFIG_THERMISTOR_STATS && CONFIG_THERMISTOR_NVS_CACHE
+        th->stats.nvs_misses++;
+#endif
+
+        th->calibrated = thermistor_adc_get_calibration(ADC_ATTEN_DB_12, &th->adc_cali_h);
+
+#if CONFIG_THERMISTOR_LUT
+        err = thermistor_lut_build(th);
+        if (err != ESP_OK) {
+            thermistor_deinit(th);
+        }
+#endif
     }
     
     return err;
 }
 
-float thermistor_vout_to_celsius(thermistor_handle_t* th, uint32_t vout)
+esp_err_t thermistor_deinit(thermistor_handle_t* th)
+{
+    if ((th->sampling_task != NULL) || th->async_pending) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (th->excitation.measure_vsource) {
+        thermistor_adc_remove_channel(th->excitation.vsource_channel);
+        th->excitation.measure_vsource = false;
+    }
+
+    thermistor_set_autorange(th, false);
+
+    if (th->sampling_timer != NULL) {
+        esp_timer_delete(th->sampling_timer);
+        th->sampling_timer = NULL;
+    }
+
+    // Freed in the reverse order of the allocation, the LUT is built after the calibration.
+    // Both tables are in the block of the first one.
+    if (th->lut_buffer[0].owned) {
+        thermistor_free((void*)th->lut_buffer[0].table);
+    }
+    th->lut = NULL;
+    for (uint32_t i = 0; i < 2; i++) {
+        th->lut_buffer[i].table = NULL;
+        th->lut_buffer[i].capacity = 0;
+        th->lut_buffer[i].owned = false;
+    }
+
+    if (th->cali_table != NULL) {
+        // Loaded from NVS, the scheme was not created.
+        thermistor_free((void*)th->cali_table);
+        th->cali_table = NULL;
+    } else {
+        thermistor_adc_put_calibration(ADC_ATTEN_DB_12);
+    }
+    th->adc_cali_h = NULL;
+    th->calibrated = false;
+
+    // The ULP releases the channel when it takes it.
+    esp_err_t err = thermistor_adc_remove_channel(th->channel);
+
+    th->adc_h = NULL;
+    th->adc_cont_h = NULL;
+
+    return (err == ESP_ERR_NOT_FOUND) ? ESP_OK : err;
+}
+
+/**
+ * @brief Applies a model to the vout of a divider, and stores the resistance
+ *        of the thermistor in t_resistance.
+ */
+static float divider_vout_to_celsius(const thermistor_coeffs_t* coeffs, float serial_resistance, 
+                                     float vsource, uint32_t vout, float* t_resistance)
 {
-    float steinhart;
-       
     // Rt = R1 * Vout / (Vs - Vout);
-    th->t_resistance =  (th->serial_resistance * vout) / (th->vsource - vout); 
+    *t_resistance =  (serial_resistance * vout) / (vsource - vout); 
 
-    steinhart = th->t_resistance / th->nominal_resistance;  // (R/Ro)
-    steinhart = log(steinhart);                             // ln(R/Ro)
-    steinhart /= th->beta_val;                              // 1/B * ln(R/Ro)
-    steinhart += 1.0 / (th->nominal_temperature + 273.15);  // + (1/To)
-    steinhart = 1.0 / steinhart;                            // Invert
-    steinhart -= 273.15;                                    // convert to C
- 
-    return steinhart; 
+    return thermistor_model_celsius(coeffs, *t_resistance);
 }
 
-uint32_t thermistor_read_vout(thermistor_handle_t* th)
+/**
+ * @brief Applies the active model of the thermistor, and stores the resistance
+ *        of the thermistor in t_resistance.
+ */
+static float equation_vout_to_celsius(const thermistor_handle_t* th, uint32_t vout, 
+                                      float* t_resistance)
+{
+    return divider_vout_to_celsius(th->coeffs, th->serial_resistance, th->vsource, vout, t_resistance);
+}
+
+/**
+ * @brief Starts a conversion with the active parameters, it is repeated while params_retry() is true.
+ */
+static uint32_t params_begin(const thermistor_handle_t* th)
+{
+    return __atomic_load_n(&th->params_seq, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Checks that the parameters were not switched during the conversion started with seq.
+ *
+ * params_apply() increments the sequence before it rewrites the spare copies,
+ * so a conversion that read the old copies, or some of the new fields, is 
+ * repeated with the new ones.
+ */
+static bool params_retry(const thermistor_handle_t* th, uint32_t seq)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    return __atomic_load_n(&th->params_seq, __ATOMIC_RELAXED) != seq;
+}
+
+/**
+ * @brief Interpolates the temperature between the two entries around vout.
+ */
+static int32_t lut_lookup(const thermistor_lut_t* lut, uint32_t vout)
+{
+    uint32_t index = vout >> lut->shift;
+    
+    if (index >= (uint32_t)(lut->size - 1)) {
+        return lut->table[lut->size - 1];
+    }
+
+    int32_t t0 = lut->table[index];
+    int32_t t1 = lut->table[index + 1];
+    int32_t frac = vout & ((1 << lut->shift) - 1);
+    
+    return t0 + (((t1 - t0) * frac) >> lut->shift);
+}
+
+/**
+ * @brief Computes the value of the entry of vout, saturated to the int16 range.
+ */
+static int16_t lut_entry(const thermistor_coeffs_t* coeffs, float serial_resistance, float vsource, 
+                         uint32_t vout)
+{
+    float t_resistance;
+    
+    if (vout == 0) {
+        return INT16_MAX;   // Shorted thermistor, hotter than the range of the table.
+    }
+
+    if (vout >= vsource) {
+        return INT16_MIN;   // Open thermistor, colder than the range of the table.
+    }
+
+    float centi = divider_vout_to_celsius(coeffs, serial_resistance, vsource, vout, &t_resistance) * 100.0f;
+
+    // Below absolute zero the equation is outside its domain (R close to 0).
+    if (!isfinite(centi) || (centi < -27315.0f) || (centi > INT16_MAX)) {
+        return INT16_MAX;
+    }
+
+    if (centi < INT16_MIN) {
+        return INT16_MIN;
+    }
+
+    return (int16_t)lroundf(centi);
+}
+
+/**
+ * @brief Computes the entries of a reserved table for a model and a divider.
+ *
+ * The step is the configured one, or a longer one when vsource needs more 
+ * entries than the reserved ones.
+ */
+static void lut_fill(const thermistor_coeffs_t* coeffs, float serial_resistance, float vsource, 
+                     thermistor_lut_t* lut)
+{
+    uint8_t shift = CONFIG_THERMISTOR_LUT_STEP_SHIFT;
+
+    while ((shift < 31) && ((((uint32_t)vsource >> shift) + 2) > lut->capacity)) {
+        shift++;
+    }
+
+    int16_t* table = (int16_t*)lut->table;
+
+    lut->size = ((uint32_t)vsource >> shift) + 2;
+    lut->shift = shift;
+    for (uint32_t i = 0; i < lut->size; i++) {
+        table[i] = lut_entry(coeffs, serial_resistance, vsource, i << shift);
+    }
+}
+
+int16_t* thermistor_lut_reserve(thermistor_handle_t* th, uint16_t size, uint8_t shift)
+{
+    // The spare table takes the next change of the parameters, so the readings never allocate.
+    int16_t* block = thermistor_alloc(2 * size * sizeof(int16_t));
+
+    if (block == NULL) {
+        ESP_LOGE(TAG, "no memory for the lookup tables of %u entries", size);
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < 2; i++) {
+        th->lut_buffer[i].table = block + (i * size);
+        th->lut_buffer[i].size = size;
+        th->lut_buffer[i].shift = shift;
+        th->lut_buffer[i].capacity = size;
+        th->lut_buffer[i].owned = true;
+    }
+
+    th->lut = &th->lut_buffer[th->coeffs - th->coeffs_buffer];
+
+    return (int16_t*)th->lut->table;
+}
+
+esp_err_t thermistor_lut_build(thermistor_handle_t* th)
+{
+#if CONFIG_THERMISTOR_LUT_ROM
+    thermistor_lut_t* lut = &th->lut_buffer[th->coeffs - th->coeffs_buffer];
+
+    // The table generated at build time is only valid for the sdkconfig parameters.
+    if ((th->coeffs->model == THERMISTOR_MODEL_BETA) &&
+        (th->serial_resistance == CONFIG_SERIE_RESISTANCE) &&
+        (th->nominal_resistance == CONFIG_NOMINAL_RESISTANCE) &&
+        (th->nominal_temperature == CONFIG_NOMINAL_TEMPERATURE) &&
+        (th->beta_val == CONFIG_BETA_VALUE) &&
+        (th->vsource == CONFIG_VOLTAGE_SOURCE)) {
+        lut->table = thermistor_lut_rom;
+        lut->size = sizeof(thermistor_lut_rom) / sizeof(thermistor_lut_rom[0]);
+        lut->shift = THERMISTOR_LUT_ROM_SHIFT;
+        lut->capacity = 0;
+        lut->owned = false;
+        th->lut = lut;
+        return ESP_OK;
+    }
+#endif
+
+    uint8_t shift = CONFIG_THERMISTOR_LUT_STEP_SHIFT;
+    uint16_t size = ((uint32_t)th->vsource >> shift) + 2;
+
+    if (thermistor_lut_reserve(th, size, shift) == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    lut_fill(th->coeffs, th->serial_resistance, th->vsource, (thermistor_lut_t*)th->lut);
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Converts a vout with the active parameters, the caller checks params_retry().
+ *
+ * @return True if the equation calculated the resistance, false with the lookup table.
+ */
+static bool fill_reading(const thermistor_handle_t* th, uint32_t vout, thermistor_reading_t* reading)
+{
+    reading->vout = vout;
+    reading->resistance = 0;
+
+#if CONFIG_THERMISTOR_LUT
+    const thermistor_lut_t* lut = th->lut;
+
+    if (lut != NULL) {
+        reading->celsius = lut_lookup(lut, vout) / 100.0f;
+        return false;
+    }
+#endif
+
+    reading->celsius = equation_vout_to_celsius(th, vout, &reading->resistance);
+
+    return true;
+}
+
+float thermistor_vout_to_celsius(thermistor_handle_t* th, uint32_t vout)
+{
+    thermistor_reading_t reading;
+    bool equation;
+    uint32_t seq;
+
+    do {
+        seq = params_begin(th);
+        equation = fill_reading(th, vout, &reading);
+    } while (params_retry(th, seq));
+
+    if (equation) {
+        th->t_resistance = reading.resistance;
+    }
+
+    return reading.celsius;
+}
+
+void thermistor_fill_reading(const thermistor_handle_t* th, uint32_t vout, 
+                             thermistor_reading_t* reading)
+{
+    uint32_t seq;
+
+    do {
+        seq = params_begin(th);
+        fill_reading(th, vout, reading);
+    } while (params_retry(th, seq));
+}
+
+int32_t thermistor_vout_to_centi_celsius(thermistor_handle_t* th, uint32_t vout)
+{
+#if CONFIG_THERMISTOR_LUT
+    int32_t centi;
+    uint32_t seq;
+
+    // The entries are int16, INT32_MIN marks a conversion without table.
+    do {
+        seq = params_begin(th);
+
+        const thermistor_lut_t* lut = th->lut;
+
+        centi = (lut != NULL) ? lut_lookup(lut, vout) : INT32_MIN;
+    } while (params_retry(th, seq));
+
+    if (centi != INT32_MIN) {
+        return centi;
+    }
+#endif
+
+    return (int32_t)lroundf(thermistor_vout_to_celsius(th, vout) * 100.0f);
+}
+
+/**
+ * @brief Averages a burst of blocking oneshot conversions.
+ */
+#if CONFIG_THERMISTOR_MATH_FLOAT
+static esp_err_t oneshot_read_raw(thermistor_handle_t* th, int* out_raw)
 {
 int adc_raw;
-int voltage = 0;
-esp_err_t err;
+esp_err_t err = ESP_OK;
+uint32_t sum = 0;   // Samples of 12 bits can't overflow the burst, the sum is exact.
+uint32_t i;
+
+   thermistor_adc_lock();
+
+   for (i = 0; i < th->samples; i++) {
+      err = adc_oneshot_read(th->adc_h, th->channel, &adc_raw);
+      
+      if(err != ESP_OK) {
+         break;
+      }
+
+      sum += adc_raw;
+   }
+
+   thermistor_adc_unlock();
+   
+   if (err == ESP_OK) {
+      *out_raw = (int)thermistor_adc_average(sum, i);
+   }
+
+   return err;
+}
+#else
+static esp_err_t oneshot_read_raw(thermistor_handle_t* th, int* out_raw)
+{
+int adc_raw;
+esp_err_t err = ESP_OK;
    
 double sum = 0.0f;
 double c = 0.0f; // Variable to store the error
@@ -106,7 +536,9 @@ int i;
 
    // Use multiple samples to stabilize the measured value, and 
    // implement the Kahan summation algorithm to reduce the int error.
-   for (i = 0; i < NO_OF_SAMPLES; i++) {
+   thermistor_adc_lock();
+
+   for (i = 0; i < (int)th->samples; i++) {
       err = adc_oneshot_read(th->adc_h, th->channel, &adc_raw);
       
       if(err != ESP_OK) {
@@ -127,72 +559,1228 @@ int i;
       c = (t - sum) - y;
       sum = t;
    }
+
+   thermistor_adc_unlock();
    
-   adc_raw = (int)(sum/i);
-     
-   if ((err== ESP_OK) && (th->calibrated)) {
+   if (err == ESP_OK) {
+      *out_raw = (int)(sum/i);
+   }
+
+   return err;
+}
+#endif
+
+/**
+ * @brief Interpolates the voltage between the two entries of the cached calibration.
+ */
+static int cali_lookup(const uint16_t* table, int adc_raw)
+{
+   uint32_t index = (uint32_t)adc_raw >> THERMISTOR_CALI_SHIFT;
+
+   if (index >= (THERMISTOR_CALI_SIZE - 1)) {
+      return table[THERMISTOR_CALI_SIZE - 1];
+   }
+
+   int v0 = table[index];
+   int v1 = table[index + 1];
+   int frac = adc_raw & ((1 << THERMISTOR_CALI_SHIFT) - 1);
+
+   // Rounded, the table adds at most 0.5 mV to the error of the scheme.
+   return v0 + ((((v1 - v0) * frac) + (1 << (THERMISTOR_CALI_SHIFT - 1))) >> THERMISTOR_CALI_SHIFT);
+}
+
+/**
+ * @brief Converts a raw code to mV with the calibration scheme.
+ */
+static int raw_to_mv(const thermistor_handle_t* th, int adc_raw)
+{
+   int voltage = 0;
+
+   if (th->cali_table != NULL) {
+      voltage = cali_lookup(th->cali_table, adc_raw);
+   } else if (th->calibrated) {
       adc_cali_raw_to_voltage(th->adc_cali_h, adc_raw, &voltage);
    }
-   
+
    return voltage;
 }
 
-float thermistor_get_celsius(thermistor_handle_t* th)
+/**
+ * @brief Applies the correction of the board to a calibrated voltage.
+ */
+static uint32_t correct_mv(const thermistor_handle_t* th, int voltage)
 {
-    th->vout = thermistor_read_vout(th);
-    
-    return thermistor_vout_to_celsius(th, th->vout);
+   if ((voltage > 0) && ((th->cali_gain != 1.0f) || (th->cali_offset_mv != 0))) {
+      voltage = (int)lroundf(voltage * th->cali_gain) + th->cali_offset_mv;
+      if (voltage < 0) {
+         voltage = 0;
+      }
+   }
+
+   return voltage;
 }
 
-float thermistor_celsius_to_fahrenheit(float temp)
+/**
+ * @brief Converts an averaged raw code to mV with the calibration scheme, 
+ *        and applies the correction of the board.
+ */
+static uint32_t raw_to_vout(const thermistor_handle_t* th, int adc_raw)
 {
-    return (temp * 1.8) + 32;
+   if (th->ratiometric) {
+      return (uint32_t)lroundf(adc_raw * (th->vsource / th->full_scale_raw));
+   }
+
+   return correct_mv(th, raw_to_mv(th, adc_raw));
 }
 
-static bool adc_calibration_init(adc_unit_t unit, adc_atten_t atten, adc_cali_handle_t *out_handle)
+/**
+ * @brief Converts a raw code of a burst to mV with the scheme of the selected attenuation.
+ */
+static int range_raw_to_mv(const thermistor_handle_t* th, int adc_raw)
 {
-    adc_cali_handle_t handle = NULL;
-    esp_err_t ret = ESP_FAIL;
-    bool calibrated = false;
+   int voltage = 0;
 
-#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
-    if (!calibrated) {
-        ESP_LOGI(TAG, "calibration scheme version is %s", "Curve Fitting");
-        adc_cali_curve_fitting_config_t cali_config = {
-            .unit_id = unit,
-            .atten = atten,
-            .bitwidth = ADC_BITWIDTH_DEFAULT,
-        };
-        ret = adc_cali_create_scheme_curve_fitting(&cali_config, &handle);
-        if (ret == ESP_OK) {
-            calibrated = true;
-        }
-    }
-#endif
+   if (th->range.atten < ADC_ATTEN_DB_12) {
+      adc_cali_raw_to_voltage(th->range.cali_h[th->range.atten], adc_raw, &voltage);
+   } else {
+      voltage = raw_to_mv(th, adc_raw);
+   }
 
-#if ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
-    if (!calibrated) {
-        ESP_LOGI(TAG, "calibration scheme version is %s", "Line Fitting");
-        adc_cali_line_fitting_config_t cali_config = {
-            .unit_id = unit,
-            .atten = atten,
-            .bitwidth = ADC_BITWIDTH_DEFAULT,
-        };
-        ret = adc_cali_create_scheme_line_fitting(&cali_config, &handle);
-        if (ret == ESP_OK) {
-            calibrated = true;
-        }
-    }
-#endif
+   return voltage;
+}
 
-    *out_handle = handle;
-    if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "Calibration Success");
-    } else if (ret == ESP_ERR_NOT_SUPPORTED || !calibrated) {
-        ESP_LOGW(TAG, "eFuse not burnt, skip software calibration");
-    } else {
-        ESP_LOGE(TAG, "Invalid arg or no memory");
+/**
+ * @brief Moves the channel to another attenuation, the filter restarts with the new scale.
+ */
+static esp_err_t range_switch(thermistor_handle_t* th, adc_atten_t atten)
+{
+   if (atten == th->range.atten) {
+      return ESP_OK;
+   }
+
+   esp_err_t err = thermistor_adc_set_atten(th->channel, atten);
+
+   if (err == ESP_OK) {
+      th->range.atten = atten;
+      thermistor_filter_reset(&th->filter);
+   }
+
+   return err;
+}
+
+/**
+ * @brief Selects the attenuation of the next burst from the voltage of the last one.
+ */
+static void range_select(thermistor_handle_t* th, int mv)
+{
+   adc_atten_t atten = th->range.atten;
+
+   // Between 80 % of the lower range and 90 % of the current one the attenuation is kept.
+   while ((atten < ADC_ATTEN_DB_12) && (mv > (s_range_max_mv[atten] * 9) / 10)) {
+      atten++;
+   }
+
+   while ((atten > ADC_ATTEN_DB_0) && (mv < (s_range_max_mv[atten - 1] * 8) / 10)) {
+      atten--;
+   }
+
+   range_switch(th, atten);
+}
+
+float thermistor_raw_to_celsius(const thermistor_handle_t* th, int adc_raw)
+{
+    thermistor_reading_t reading;
+    uint32_t seq;
+
+    do {
+        seq = params_begin(th);
+        fill_reading(th, raw_to_vout(th, adc_raw), &reading);
+    } while (params_retry(th, seq));
+
+    return reading.celsius;
+}
+
+esp_err_t thermistor_celsius_to_raw(const thermistor_handle_t* th, float celsius, int* adc_raw)
+{
+    if (!th->calibrated && !th->ratiometric) {
+        return ESP_ERR_INVALID_STATE;
     }
 
-    return calibrated;
+    int low;
+    uint32_t seq;
+
+    do {
+        seq = params_begin(th);
+
+        // Vout = Vs * Rt / (R1 + Rt), with the last measured rail the codes follow its drift.
+        float vsource = th->vsource;
+
+        if (!th->ratiometric && th->excitation.measure_vsource && (th->excitation.vsource_mv > 0)) {
+            vsource = th->excitation.vsource_mv;
+        }
+
+        float resistance = thermistor_model_resistance(th->coeffs, celsius);
+        uint32_t vout = (uint32_t)lroundf((vsource * resistance) / (th->serial_resistance + resistance));
+        int high = (1 << SOC_ADC_RTC_MAX_BITWIDTH) - 1;
+
+        low = 0;
+
+        // The calibration is monotonic, search the first code that reaches vout.
+        while (low < high) {
+            int mid = (low + high) / 2;
+
+            if (raw_to_vout(th, mid) < vout) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+    } while (params_retry(th, seq));
+
+    *adc_raw = low;
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Converts the setpoints of the alarms to raw codes with the parameters of the handle.
+ */
+static esp_err_t alarm_build(const thermistor_handle_t* th, const thermistor_alarm_config_t* config, 
+                             thermistor_alarm_t* alarm)
+{
+    int raw;
+
+    thermistor_alarm_disable(alarm);
+
+    if (isfinite(config->high_celsius)) {
+        if (thermistor_celsius_to_raw(th, config->high_celsius, &raw) != ESP_OK) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        alarm->high_set = raw;
+
+        thermistor_celsius_to_raw(th, config->high_celsius - config->hysteresis, &raw);
+        alarm->high_clear = raw;
+    }
+
+    if (isfinite(config->low_celsius)) {
+        if (thermistor_celsius_to_raw(th, config->low_celsius, &raw) != ESP_OK) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        alarm->low_set = raw;
+
+        thermistor_celsius_to_raw(th, config->low_celsius + config->hysteresis, &raw);
+        alarm->low_clear = raw;
+    }
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Returns the rail that the raw codes of the alarms depend on.
+ */
+static float alarm_rail(const thermistor_handle_t* th)
+{
+    if (th->ratiometric) {
+        return th->full_scale_raw;
+    }
+
+    return (th->excitation.measure_vsource && (th->excitation.vsource_mv > 0)) ? 
+           th->excitation.vsource_mv : th->vsource;
+}
+
+/**
+ * @brief Converts the setpoints of the alarms again, keeping their state.
+ */
+static void alarm_refresh(thermistor_handle_t* th)
+{
+    thermistor_alarm_t alarm;
+
+    th->excitation.alarm_rail = alarm_rail(th);
+
+    if (!isfinite(th->alarm_config.high_celsius) && !isfinite(th->alarm_config.low_celsius)) {
+        return;
+    }
+
+    // The next reading compares with the new codes.
+    if (alarm_build(th, &th->alarm_config, &alarm) == ESP_OK) {
+        alarm.active = th->alarm.active;
+        th->alarm = alarm;
+    }
+}
+
+/**
+ * @brief Powers the divider and waits for it to settle.
+ */
+static void excitation_on(const thermistor_excitation_t* excitation)
+{
+   if (excitation->gpio != GPIO_NUM_NC) {
+      gpio_set_level(excitation->gpio, excitation->on_level);
+      if (excitation->settle_us > 0) {
+         esp_rom_delay_us(excitation->settle_us);
+      }
+   }
+}
+
+static void excitation_off(const thermistor_excitation_t* excitation)
+{
+   if (excitation->gpio != GPIO_NUM_NC) {
+      gpio_set_level(excitation->gpio, !excitation->on_level);
+   }
+}
+
+/**
+ * @brief Stores the rail measured in the reference channel, and follows it with the alarms.
+ */
+static void excitation_update(thermistor_handle_t* th, int ref_raw)
+{
+   if (th->ratiometric) {
+      th->full_scale_raw = ref_raw * th->excitation.vsource_ratio;
+   } else {
+      // Corrected as the vout, so the gain of the board cancels in the ratio.
+      th->excitation.vsource_mv = correct_mv(th, raw_to_mv(th, ref_raw)) * th->excitation.vsource_ratio;
+   }
+
+   float rail = alarm_rail(th);
+
+   // The codes are converted again when the rail moves more than 1/1024, up to 4 codes of a threshold.
+   if (fabsf(rail - th->excitation.alarm_rail) > (rail / RAIL_TOLERANCE_DIV)) {
+      alarm_refresh(th);
+   }
+}
+
+/**
+ * @brief Refers a vout to the nominal vsource, with the last rail measured.
+ */
+static uint32_t vout_to_nominal(const thermistor_handle_t* th, uint32_t vout)
+{
+   // Rt = R1 * Vout / (Vs - Vout) only depends on the ratio Vout / Vs.
+   if (!th->ratiometric && th->excitation.measure_vsource && (th->excitation.vsource_mv > 0)) {
+      return (uint32_t)lroundf(vout * (th->vsource / th->excitation.vsource_mv));
+   }
+
+   return vout;
+}
+
+#if CONFIG_THERMISTOR_STATS
+/**
+ * @brief Counts a burst of the thermistor, and adds its time to the histogram.
+ */
+static void stats_burst(thermistor_handle_t* th, esp_err_t err, int64_t elapsed_us)
+{
+   th->stats.reads++;
+
+   if (err != ESP_OK) {
+      th->stats.read_errors++;
+      th->stats.last_error = err;
+   } else {
+      thermistor_histogram_add(&th->stats.burst_us, (uint32_t)elapsed_us);
+   }
+}
+#endif
+
+/**
+ * @brief Averages a burst of the thermistor, and of the reference channel when the rail is measured.
+ */
+static esp_err_t scan_burst(thermistor_handle_t* th, int* adc_raw)
+{
+esp_err_t err;
+
+   if (th->excitation.measure_vsource) {
+      adc_channel_t channels[2] = { th->channel, th->excitation.vsource_channel };
+
+      err = thermistor_adc_scan(channels, 2, th->samples, adc_raw);
+   } else {
+#if CONFIG_THERMISTOR_ADC_MODE_CONTINUOUS
+      err = thermistor_adc_scan(&th->channel, 1, th->samples, &adc_raw[0]);
+#else
+      err = oneshot_read_raw(th, &adc_raw[0]);
+#endif
+   }
+
+   return err;
+}
+
+/**
+ * @brief Averages a burst, and stores the rail measured in the reference channel.
+ */
+static esp_err_t read_burst(thermistor_handle_t* th, int* adc_raw)
+{
+   esp_err_t err = scan_burst(th, adc_raw);
+
+   if ((err == ESP_OK) && th->excitation.measure_vsource) {
+      excitation_update(th, adc_raw[1]);
+   }
+
+   return err;
+}
+
+/**
+ * @brief Classifies an unfiltered raw code by the bounds of the divider.
+ */
+static thermistor_fault_t fault_classify(const thermistor_handle_t* th, int adc_raw)
+{
+   int open_raw = th->fault_open_raw;
+
+   // Rt = R1 * raw / (FS - raw) has no solution near the full scale of the rail.
+   if (th->ratiometric && ((th->full_scale_raw - THERMISTOR_FAULT_MARGIN) < open_raw)) {
+      open_raw = (int)th->full_scale_raw - THERMISTOR_FAULT_MARGIN;
+   }
+
+   if (adc_raw <= th->fault_short_raw) {
+      return THERMISTOR_FAULT_SHORT;
+   }
+
+   // Below 12 dB a clipped burst was already repeated with a higher attenuation.
+   if ((th->range.atten == ADC_ATTEN_DB_12) && (adc_raw >= open_raw)) {
+      return THERMISTOR_FAULT_OPEN;
+   }
+
+   return THERMISTOR_FAULT_NONE;
+}
+
+/**
+ * @brief Updates the fault of the handle, and filters the raw code while there is none.
+ */
+static int fault_update(thermistor_handle_t* th, int adc_raw)
+{
+   thermistor_fault_t fault = fault_classify(th, adc_raw);
+
+   if (fault != THERMISTOR_FAULT_NONE) {
+      // The filter restarts after the repair, without the codes of the fault.
+      if (th->fault == THERMISTOR_FAULT_NONE) {
+         thermistor_filter_reset(&th->filter);
+      }
+      th->fault = fault;
+      return adc_raw;
+   }
+
+   th->fault = THERMISTOR_FAULT_NONE;
+
+   return thermistor_filter_update(&th->filter, adc_raw);
+}
+
+/**
+ * @brief Reads the averaged raw code of the thermistor and applies the filter.
+ */
+static esp_err_t read_raw(thermistor_handle_t* th, int* out_raw)
+{
+int adc_raw[2];
+esp_err_t err;
+
+#if CONFIG_THERMISTOR_STATS
+   int64_t start_us = esp_timer_get_time();
+#endif
+
+   excitation_on(&th->excitation);
+
+   err = read_burst(th, adc_raw);
+
+   // A clipped burst is repeated with the next attenuation.
+   while ((err == ESP_OK) && th->range.enabled && 
+          (adc_raw[0] >= RANGE_SATURATED) && (th->range.atten < ADC_ATTEN_DB_12)) {
+      err = range_switch(th, th->range.atten + 1);
+      if (err == ESP_OK) {
+         err = read_burst(th, adc_raw);
+      }
+   }
+
+   excitation_off(&th->excitation);
+
+#if CONFIG_THERMISTOR_STATS
+   stats_burst(th, err, esp_timer_get_time() - start_us);
+#endif
+     
+   if (err == ESP_OK) {
+      *out_raw = fault_update(th, adc_raw[0]);
+   }
+
+   return err;
+}
+
+/**
+ * @brief Converts a raw code with the ratio to the full scale, Rt = R1 * raw / (FS - raw).
+ */
+static void ratiometric_fill(const thermistor_handle_t* th, int adc_raw, thermistor_reading_t* reading)
+{
+#if CONFIG_THERMISTOR_LUT
+    if (th->lut != NULL) {
+        fill_reading(th, raw_to_vout(th, adc_raw), reading);
+        return;
+    }
+#endif
+
+    reading->vout = raw_to_vout(th, adc_raw);
+    reading->resistance = (th->serial_resistance * adc_raw) / (th->full_scale_raw - adc_raw);
+    reading->celsius = thermistor_model_celsius(th->coeffs, reading->resistance);
+}
+
+/**
+ * @brief Converts a raw code as the readings of the handle.
+ */
+static void raw_fill_reading(const thermistor_handle_t* th, int adc_raw, thermistor_reading_t* reading)
+{
+    uint32_t seq;
+
+    do {
+        seq = params_begin(th);
+        if (th->ratiometric) {
+            ratiometric_fill(th, adc_raw, reading);
+        } else {
+            fill_reading(th, vout_to_nominal(th, raw_to_vout(th, adc_raw)), reading);
+        }
+    } while (params_retry(th, seq));
+}
+
+thermistor_conversion_t thermistor_vout_to_conversion(const thermistor_handle_t* th, uint32_t vout)
+{
+    thermistor_reading_t reading;
+
+    thermistor_fill_reading(th, vout, &reading);
+
+    return (thermistor_conversion_t) {
+        .vout = reading.vout,
+        .resistance = reading.resistance,
+        .celsius = reading.celsius,
+    };
+}
+
+thermistor_conversion_t thermistor_raw_to_conversion(const thermistor_handle_t* th, int adc_raw)
+{
+    thermistor_reading_t reading;
+
+    raw_fill_reading(th, adc_raw, &reading);
+
+    return (thermistor_conversion_t) {
+        .vout = reading.vout,
+        .resistance = reading.resistance,
+        .celsius = reading.celsius,
+    };
+}
+
+/**
+ * @brief Refers a raw code of the selected attenuation to the 12 dB range, with its voltage in mV.
+ */
+static int range_full_scale_raw(const thermistor_handle_t* th, int adc_raw, int mv)
+{
+    if (th->range.atten == ADC_ATTEN_DB_12) {
+        return adc_raw;
+    }
+
+    float raw = (mv - th->range.offset_mv) / th->range.mv_per_code;
+
+    return (raw <= 0) ? 0 : (raw >= RANGE_FULL_CODE) ? RANGE_FULL_CODE : (int)lroundf(raw);
+}
+
+/**
+ * @brief Converts a raw code of the selected attenuation, and selects the next one.
+ *
+ * @return
+ *      - Equivalent raw code of the 12 dB range.
+ */
+static int range_fill_reading(thermistor_handle_t* th, int adc_raw, thermistor_reading_t* reading)
+{
+    int mv = range_raw_to_mv(th, adc_raw);
+
+    adc_raw = range_full_scale_raw(th, adc_raw, mv);
+
+    thermistor_fill_reading(th, vout_to_nominal(th, correct_mv(th, mv)), reading);
+    range_select(th, mv);
+
+    return adc_raw;
+}
+
+/**
+ * @brief Converts the raw code of a reading, and stores it in the ring.
+ */
+static void complete_reading(thermistor_handle_t* th, int adc_raw, thermistor_reading_t* reading)
+{
+    reading->fault = th->fault;
+
+    // A faulted reading is not converted, the equations diverge at the ends of the range.
+    if (th->fault != THERMISTOR_FAULT_NONE) {
+        reading->raw = adc_raw;
+        reading->vout = 0;
+        reading->resistance = 0;
+        reading->celsius = NAN;
+        reading->alarms = th->alarm.active;
+        return;
+    }
+
+#if CONFIG_THERMISTOR_STATS
+    uint32_t start_cycles = esp_cpu_get_cycle_count();
+#endif
+
+    if (th->range.enabled) {
+        adc_raw = range_fill_reading(th, adc_raw, reading);
+    } else {
+        raw_fill_reading(th, adc_raw, reading);
+    }
+
+#if CONFIG_THERMISTOR_STATS
+    thermistor_histogram_add(&th->stats.convert_cycles, esp_cpu_get_cycle_count() - start_cycles);
+    if (!th->calibrated && !th->ratiometric) {
+        th->stats.cali_fallbacks++;
+    }
+#endif
+    reading->raw = adc_raw;
+    reading->alarms = thermistor_alarm_update(&th->alarm, adc_raw);
+
+    if (th->ring != NULL) {
+        float centi = reading->celsius * 100.0f;
+        thermistor_sample_t sample = {
+            .timestamp_us = reading->timestamp_us,
+            .raw = reading->raw,
+            .vout = reading->vout,
+            .centi_celsius = (centi >= INT16_MAX) ? INT16_MAX : 
+                             !(centi > INT16_MIN) ? INT16_MIN : (int16_t)lroundf(centi),
+        };
+
+        thermistor_ring_push(th->ring, &sample);
+    }
+}
+
+/**
+ * @brief Takes the parameters changed by the setters, and rebuilds the data derived from them.
+ *
+ * The spare coefficients and table are filled outside of the critical 
+ * section, and they replace the active ones under the lock with the divider.
+ * Each switch increments params_seq, and the conversions repeat themselves
+ * when it changes (see params_retry()), so none of them mixes the old and 
+ * the new parameters, even while a later change rewrites the old copies.
+ */
+static esp_err_t params_apply(thermistor_handle_t* th)
+{
+    thermistor_params_t params;
+    esp_err_t err = ESP_OK;
+
+    if (th->params.pending == 0) {
+        return ESP_OK;
+    }
+
+    // The copy is consistent, the rebuild is done outside of the critical section.
+    portENTER_CRITICAL(&th->params.lock);
+    params = th->params;
+    th->params.pending = 0;
+    portEXIT_CRITICAL(&th->params.lock);
+
+    uint32_t spare = (th->coeffs == &th->coeffs_buffer[0]) ? 1 : 0;
+
+    // A conversion that still reads the spare copies started before the last switch, its sequence is old.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    thermistor_coeffs_t* coeffs = &th->coeffs_buffer[spare];
+    float serial_resistance = th->serial_resistance;
+    float vsource = th->vsource;
+
+    *coeffs = *th->coeffs;
+
+    if (params.pending & PARAMS_DIVIDER) {
+        serial_resistance = params.serial_resistance;
+        vsource = params.vsource;
+    }
+
+    if (params.pending & PARAMS_BETA) {
+        thermistor_model_config_t model = {
+            .model = THERMISTOR_MODEL_BETA,
+            .beta = params.beta,
+        };
+
+        th->nominal_resistance = params.beta.nominal_resistance;
+        th->nominal_temperature = params.beta.nominal_temperature;
+        th->beta_val = params.beta.beta_val;
+        thermistor_model_prepare(coeffs, &model);
+    }
+
+    const thermistor_lut_t* lut = NULL;
+
+#if CONFIG_THERMISTOR_LUT
+    // The ROM table has no spare, it can only be replaced by the equation.
+    if (th->lut_buffer[spare].owned) {
+        lut_fill(coeffs, serial_resistance, vsource, &th->lut_buffer[spare]);
+        lut = &th->lut_buffer[spare];
+    } else if (th->lut != NULL) {
+        ESP_LOGE(TAG, "no lookup table for the new parameters, the equation of the model is used");
+        err = ESP_ERR_NO_MEM;
+    }
+#endif
+
+    // The conversions that overlap the switch, or the next rewrite of these copies, see a new sequence.
+    portENTER_CRITICAL(&th->params.lock);
+    th->serial_resistance = serial_resistance;
+    th->vsource = vsource;
+    th->coeffs = coeffs;
+    th->lut = lut;
+    __atomic_store_n(&th->params_seq, th->params_seq + 1, __ATOMIC_RELEASE);
+    portEXIT_CRITICAL(&th->params.lock);
+
+    alarm_refresh(th);
+
+    return err;
+}
+
+uint32_t thermistor_read_vout(thermistor_handle_t* th)
+{
+    int adc_raw;
+
+    params_apply(th);
+
+    if ((read_raw(th, &adc_raw) != ESP_OK) || (th->fault != THERMISTOR_FAULT_NONE)) {
+        return 0;
+    }
+
+    if (th->range.enabled) {
+        int mv = range_raw_to_mv(th, adc_raw);
+
+        range_select(th, mv);
+        return vout_to_nominal(th, correct_mv(th, mv));
+    }
+
+    return vout_to_nominal(th, raw_to_vout(th, adc_raw));
+}
+
+esp_err_t thermistor_acquire(thermistor_handle_t* th, thermistor_reading_t* reading)
+{
+    int adc_raw;
+
+    params_apply(th);
+    reading->timestamp_us = esp_timer_get_time();
+
+    esp_err_t err = read_raw(th, &adc_raw);
+
+    if (err == ESP_OK) {
+        complete_reading(th, adc_raw, reading);
+        if (reading->fault != THERMISTOR_FAULT_NONE) {
+            err = ESP_ERR_INVALID_RESPONSE;
+        }
+    } else {
+        thermistor_fill_reading(th, 0, reading);
+        reading->raw = 0;
+        reading->alarms = th->alarm.active;
+        reading->fault = THERMISTOR_FAULT_NONE;
+    }
+
+    return err;
+}
+
+esp_err_t thermistor_burst_raw(thermistor_handle_t* th, int* adc_raw)
+{
+#if CONFIG_THERMISTOR_STATS
+    int64_t start_us = esp_timer_get_time();
+#endif
+
+    excitation_on(&th->excitation);
+
+    esp_err_t err = scan_burst(th, adc_raw);
+
+    excitation_off(&th->excitation);
+
+#if CONFIG_THERMISTOR_STATS
+    stats_burst(th, err, esp_timer_get_time() - start_us);
+#endif
+
+    return err;
+}
+
+esp_err_t thermistor_process_raw(thermistor_handle_t* th, const int* adc_raw, thermistor_reading_t* reading)
+{
+    params_apply(th);
+
+    if (th->excitation.measure_vsource) {
+        excitation_update(th, adc_raw[1]);
+    }
+
+    complete_reading(th, fault_update(th, adc_raw[0]), reading);
+
+    return (reading->fault == THERMISTOR_FAULT_NONE) ? ESP_OK : ESP_ERR_INVALID_RESPONSE;
+}
+
+float thermistor_get_celsius(thermistor_handle_t* th)
+{
+    thermistor_reading_t reading;
+
+    thermistor_acquire(th, &reading);
+    th->vout = reading.vout;
+    th->t_resistance = reading.resistance;
+    
+    return reading.celsius;
+}
+
+void thermistor_set_ring(thermistor_handle_t* th, thermistor_ring_t* ring)
+{
+    if (ring != NULL) {
+        thermistor_ring_init(ring);
+    }
+
+    th->ring = ring;
+}
+
+esp_err_t thermistor_set_oversampling(thermistor_handle_t* th, uint32_t samples)
+{
+    if ((samples == 0) || (samples > THERMISTOR_MAX_OVERSAMPLING)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    th->samples = samples;
+
+    return ESP_OK;
+}
+
+esp_err_t thermistor_set_filter(thermistor_handle_t* th, const thermistor_filter_config_t* config)
+{
+    return thermistor_filter_init(&th->filter, config) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t thermistor_set_excitation(thermistor_handle_t* th, const thermistor_excitation_config_t* config)
+{
+    thermistor_excitation_t excitation = {
+        .gpio = GPIO_NUM_NC,
+    };
+
+    if (config != NULL) {
+        if (((config->gpio != GPIO_NUM_NC) && !GPIO_IS_VALID_OUTPUT_GPIO(config->gpio)) ||
+            (config->settle_us > THERMISTOR_MAX_SETTLE_US) ||
+            (config->measure_vsource && !(config->vsource_ratio > 0))) {
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        excitation.gpio = config->gpio;
+        excitation.on_level = config->active_low ? 0 : 1;
+        excitation.settle_us = config->settle_us;
+        excitation.measure_vsource = config->measure_vsource;
+        excitation.vsource_channel = config->vsource_channel;
+        excitation.vsource_ratio = config->vsource_ratio;
+    }
+
+    // The reference channel can be shared by the thermistors of the same rail.
+    if (excitation.measure_vsource && (!th->excitation.measure_vsource || 
+        (th->excitation.vsource_channel != excitation.vsource_channel))) {
+        esp_err_t err = thermistor_adc_add_shared_channel(excitation.vsource_channel, ADC_ATTEN_DB_12);
+
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    if (th->excitation.measure_vsource && (!excitation.measure_vsource || 
+        (th->excitation.vsource_channel != excitation.vsource_channel))) {
+        thermistor_adc_remove_channel(th->excitation.vsource_channel);
+    }
+
+    if (excitation.gpio != GPIO_NUM_NC) {
+        gpio_reset_pin(excitation.gpio);
+        gpio_set_direction(excitation.gpio, GPIO_MODE_OUTPUT);
+        gpio_set_level(excitation.gpio, !excitation.on_level);
+    }
+
+    th->excitation = excitation;
+    alarm_refresh(th);
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Line through the calibration at 1/4 and 3/4 of the range, mV = code * gain + offset.
+ */
+static bool cali_linear_fit(const thermistor_handle_t* th, float* mv_per_code, float* offset_mv)
+{
+    const int raw_low = (1 << SOC_ADC_RTC_MAX_BITWIDTH) / 4;
+    const int raw_high = raw_low * 3;
+    int mv_low = raw_to_mv(th, raw_low);
+    int mv_high = raw_to_mv(th, raw_high);
+
+    if (mv_high <= mv_low) {
+        return false;
+    }
+
+    *mv_per_code = (float)(mv_high - mv_low) / (raw_high - raw_low);
+    *offset_mv = mv_low - (raw_low * *mv_per_code);
+
+    return true;
+}
+
+esp_err_t thermistor_get_convert(const thermistor_handle_t* th, thermistor_convert_t* conv)
+{
+    float mv_per_code = 0;
+    float offset_mv = 0;
+    uint32_t seq;
+
+    if (!th->ratiometric) {
+        if (!cali_linear_fit(th, &mv_per_code, &offset_mv)) {
+            return ESP_ERR_INVALID_STATE;
+        }
+
+        // The correction of the board is a line too.
+        mv_per_code *= th->cali_gain;
+        offset_mv = (offset_mv * th->cali_gain) + th->cali_offset_mv;
+    }
+
+    do {
+        seq = params_begin(th);
+        if (th->ratiometric) {
+            mv_per_code = th->vsource / th->full_scale_raw;
+            offset_mv = 0;
+        }
+
+        conv->coeffs = *th->coeffs;
+        conv->serial_resistance = th->serial_resistance;
+        conv->vsource = th->vsource;
+    } while (params_retry(th, seq));
+
+    conv->mv_per_code = mv_per_code;
+    conv->offset_mv = offset_mv;
+
+    return ESP_OK;
+}
+
+esp_err_t thermistor_set_ratiometric(thermistor_handle_t* th, bool enable, float full_scale_raw)
+{
+    if (!(full_scale_raw >= 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (enable && th->range.enabled) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (enable && (full_scale_raw == 0)) {
+        float mv_per_code;
+        float offset_mv;
+
+        if (!cali_linear_fit(th, &mv_per_code, &offset_mv)) {
+            return ESP_ERR_INVALID_STATE;
+        }
+
+        full_scale_raw = (th->vsource - offset_mv) / mv_per_code;
+    }
+
+    th->ratiometric = enable;
+    th->full_scale_raw = full_scale_raw;
+    alarm_refresh(th);
+
+    return ESP_OK;
+}
+
+esp_err_t thermistor_set_autorange(thermistor_handle_t* th, bool enable)
+{
+#if CONFIG_THERMISTOR_ADC_MODE_CONTINUOUS
+    return enable ? ESP_ERR_NOT_SUPPORTED : ESP_OK;
+#else
+    // The acquisition task of the pipeline reads the attenuation without a lock.
+    if (th->pipeline != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (enable == th->range.enabled) {
+        return ESP_OK;
+    }
+
+    if (!enable) {
+        range_switch(th, ADC_ATTEN_DB_12);
+        for (adc_atten_t atten = ADC_ATTEN_DB_0; atten < ADC_ATTEN_DB_12; atten++) {
+            thermistor_adc_put_calibration(atten);
+            th->range.cali_h[atten] = NULL;
+        }
+        th->range.enabled = false;
+        return ESP_OK;
+    }
+
+    if (th->ratiometric || !cali_linear_fit(th, &th->range.mv_per_code, &th->range.offset_mv)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    for (adc_atten_t atten = ADC_ATTEN_DB_0; atten < ADC_ATTEN_DB_12; atten++) {
+        if (!thermistor_adc_get_calibration(atten, &th->range.cali_h[atten])) {
+            ESP_LOGE(TAG, "no calibration for the attenuation %d", atten);
+            for (adc_atten_t taken = ADC_ATTEN_DB_0; taken <= atten; taken++) {
+                thermistor_adc_put_calibration(taken);
+                th->range.cali_h[taken] = NULL;
+            }
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+    }
+
+    // The first reading starts at 12 dB, which covers any vout.
+    th->range.atten = ADC_ATTEN_DB_12;
+    th->range.enabled = true;
+
+    return ESP_OK;
+#endif
+}
+
+esp_err_t thermistor_set_alarm(thermistor_handle_t* th, const thermistor_alarm_config_t* config)
+{
+    thermistor_alarm_t alarm;
+
+    if (config == NULL) {
+        thermistor_alarm_disable(&th->alarm);
+        th->alarm_config.high_celsius = INFINITY;
+        th->alarm_config.low_celsius = -INFINITY;
+        return ESP_OK;
+    }
+
+    if (!(config->hysteresis >= 0) || isnan(config->high_celsius) || isnan(config->low_celsius) ||
+        (isfinite(config->high_celsius) && isfinite(config->low_celsius) && 
+         !(config->low_celsius < config->high_celsius))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = alarm_build(th, config, &alarm);
+
+    if (err == ESP_OK) {
+        th->alarm = alarm;
+        th->alarm_config = *config;
+        th->excitation.alarm_rail = alarm_rail(th);
+    }
+
+    return err;
+}
+
+esp_err_t thermistor_read_alarm(thermistor_handle_t* th, uint8_t* alarms)
+{
+    int adc_raw;
+
+    params_apply(th);
+
+    esp_err_t err = read_raw(th, &adc_raw);
+
+    if (err == ESP_OK) {
+        // The thresholds are codes of the 12 dB range, as the raw codes of the readings.
+        if (th->range.enabled) {
+            int mv = range_raw_to_mv(th, adc_raw);
+
+            adc_raw = range_full_scale_raw(th, adc_raw, mv);
+            range_select(th, mv);
+        }
+
+        *alarms = thermistor_alarm_update(&th->alarm, adc_raw);
+    }
+
+    return err;
+}
+
+esp_err_t thermistor_set_fault_range(thermistor_handle_t* th, uint16_t short_raw, uint16_t open_raw)
+{
+    if (short_raw >= open_raw) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    th->fault_short_raw = short_raw;
+    th->fault_open_raw = open_raw;
+
+    return ESP_OK;
+}
+
+esp_err_t thermistor_set_divider(thermistor_handle_t* th, float serial_resistance, float vsource)
+{
+    if (!(serial_resistance > 0) || !(vsource > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&th->params.lock);
+    th->params.serial_resistance = serial_resistance;
+    th->params.vsource = vsource;
+    th->params.pending |= PARAMS_DIVIDER;
+    portEXIT_CRITICAL(&th->params.lock);
+
+    return ESP_OK;
+}
+
+esp_err_t thermistor_set_beta(thermistor_handle_t* th, const thermistor_beta_t* beta)
+{
+    if (!(beta->nominal_resistance > 0) || !(beta->beta_val > 0) || !isfinite(beta->nominal_temperature)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (th->coeffs->model != THERMISTOR_MODEL_BETA) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    portENTER_CRITICAL(&th->params.lock);
+    th->params.beta = *beta;
+    th->params.pending |= PARAMS_BETA;
+    portEXIT_CRITICAL(&th->params.lock);
+
+    return ESP_OK;
+}
+
+esp_err_t thermistor_apply_params(thermistor_handle_t* th)
+{
+    return params_apply(th);
+}
+
+esp_err_t thermistor_set_correction(thermistor_handle_t* th, float gain, int32_t offset_mv)
+{
+    if (!(gain > 0) || !isfinite(gain)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    th->cali_gain = gain;
+    th->cali_offset_mv = offset_mv;
+
+    return ESP_OK;
+}
+
+esp_err_t thermistor_get_stats(const thermistor_handle_t* th, thermistor_stats_t* stats)
+{
+#if CONFIG_THERMISTOR_STATS
+    *stats = th->stats;
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t thermistor_reset_stats(thermistor_handle_t* th)
+{
+#if CONFIG_THERMISTOR_STATS
+    thermistor_stats_reset(&th->stats);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t thermistor_group_init(thermistor_group_t* group, 
+                                thermistor_handle_t* const* sensors, size_t count)
+{
+    if ((count == 0) || (count > THERMISTOR_GROUP_MAX)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    group->count = count;
+    for (size_t i = 0; i < count; i++) {
+        group->sensors[i] = sensors[i];
+        group->channels[i] = sensors[i]->channel;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t thermistor_group_read(thermistor_group_t* group, float* celsius)
+{
+    adc_channel_t channels[THERMISTOR_GROUP_MAX];
+    int adc_raw[THERMISTOR_GROUP_MAX];
+    uint8_t ref_index[THERMISTOR_GROUP_MAX];
+    uint8_t index[THERMISTOR_GROUP_MAX];
+    size_t scanned = 0;
+    uint32_t samples = 0;
+    uint32_t settle_us = 0;
+    bool faulted = false;
+
+    // The faulted thermistors only take conversions in the retries.
+    for (size_t i = 0; i < group->count; i++) {
+        thermistor_handle_t* th = group->sensors[i];
+
+        params_apply(th);
+
+        if ((th->fault != THERMISTOR_FAULT_NONE) && (++th->fault_skips < THERMISTOR_FAULT_RETRY)) {
+            celsius[i] = NAN;
+            faulted = true;
+            continue;
+        }
+
+        th->fault_skips = 0;
+        index[scanned] = i;
+        channels[scanned++] = group->channels[i];
+    }
+
+    if (scanned == 0) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    size_t count = scanned;
+
+    for (size_t k = 0; k < scanned; k++) {
+        const thermistor_handle_t* th = group->sensors[index[k]];
+
+        // The largest oversampling of the group is the budget of the whole scan.
+        if (th->samples > samples) {
+            samples = th->samples;
+        }
+
+        if (th->excitation.settle_us > settle_us) {
+            settle_us = th->excitation.settle_us;
+        }
+
+        // The reference channels of the rails are added once at the end of the scan.
+        if (th->excitation.measure_vsource) {
+            size_t j = scanned;
+            
+            while ((j < count) && (channels[j] != th->excitation.vsource_channel)) {
+                j++;
+            }
+
+            if (j == count) {
+                if (count >= THERMISTOR_GROUP_MAX) {
+                    return ESP_ERR_INVALID_SIZE;
+                }
+                channels[count++] = th->excitation.vsource_channel;
+            }
+            ref_index[k] = j;
+        }
+    }
+
+    // Split between the channels, so the scan takes the conversions of one reading.
+    samples /= count;
+    if (samples == 0) {
+        samples = 1;
+    }
+
+#if CONFIG_THERMISTOR_STATS
+    int64_t start_us = esp_timer_get_time();
+#endif
+
+    // All the dividers are powered together, and settle with the slowest one.
+    for (size_t k = 0; k < scanned; k++) {
+        thermistor_excitation_t excitation = group->sensors[index[k]]->excitation;
+
+        excitation.settle_us = 0;
+        excitation_on(&excitation);
+    }
+
+    if (settle_us > 0) {
+        esp_rom_delay_us(settle_us);
+    }
+
+    int64_t timestamp_us = esp_timer_get_time();
+    esp_err_t err = thermistor_adc_scan(channels, count, samples, adc_raw);
+
+    for (size_t k = 0; k < scanned; k++) {
+        excitation_off(&group->sensors[index[k]]->excitation);
+    }
+
+#if CONFIG_THERMISTOR_STATS
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+
+    for (size_t k = 0; k < scanned; k++) {
+        stats_burst(group->sensors[index[k]], err, elapsed_us);
+    }
+#endif
+    
+    for (size_t k = 0; (err == ESP_OK) && (k < scanned); k++) {
+        thermistor_handle_t* th = group->sensors[index[k]];
+        thermistor_reading_t reading = {
+            .timestamp_us = timestamp_us,
+        };
+
+        if (th->excitation.measure_vsource) {
+            excitation_update(th, adc_raw[ref_index[k]]);
+        }
+
+        complete_reading(th, fault_update(th, adc_raw[k]), &reading);
+        th->vout = reading.vout;
+        th->t_resistance = reading.resistance;
+        celsius[index[k]] = reading.celsius;
+        faulted |= (reading.fault != THERMISTOR_FAULT_NONE);
+    }
+
+    if ((err == ESP_OK) && faulted) {
+        err = ESP_ERR_INVALID_RESPONSE;
+    }
+
+    return err;
+}
+
+float thermistor_celsius_to_fahrenheit(float temp)
+{
+    return (temp * MATH_CONST(1.8)) + 32;
 }
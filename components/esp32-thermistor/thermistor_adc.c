@@ -0,0 +1,476 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_adc.c
+ * @brief ADC unit manager shared by all the thermistor instances.
+ */
+
+#include "thermistor_adc.h"
+#include "thermistor_continuous.h"
+
+#include "esp_adc/adc_cali_scheme.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "sdkconfig.h"
+
+#include "esp_log.h"
+static const char* TAG = "drv_thr_adc";
+
+#define MAX_CHANNELS    SOC_ADC_PATT_LEN_MAX
+
+/**
+ * @brief Calibration scheme shared by the channels with the same attenuation.
+ */
+typedef struct {
+    adc_cali_handle_t handle;       /**< Calibration information handle. */
+    uint32_t ref_count;             /**< Number of users of the scheme. */
+    bool calibrated;                /**< The scheme was created successfully. */
+    bool curve_fitting;             /**< The scheme is curve fitting, otherwise line fitting. */
+} cali_entry_t;
+
+/**
+ * @brief State of the ADC1 unit shared by the thermistors.
+ */
+typedef struct {
+    adc_oneshot_unit_handle_t oneshot_h;    /**< Oneshot handle, in oneshot mode. */
+    adc_continuous_handle_t cont_h;         /**< Continuous handle, in continuous mode. */
+    bool running;                           /**< The continuous conversions are started. */
+    size_t channel_count;                   /**< Number of registered channels. */
+    adc_channel_t channels[MAX_CHANNELS];   /**< Registered channels, in pattern order. */
+    adc_atten_t attens[MAX_CHANNELS];       /**< Attenuation of each registered channel. */
+    uint8_t users[MAX_CHANNELS];            /**< Users of each channel, more than one if it is shared. */
+    bool shared[MAX_CHANNELS];              /**< The channel was registered as shared. */
+    cali_entry_t cali[ADC_ATTEN_DB_12 + 1]; /**< Calibration schemes by attenuation. */
+    SemaphoreHandle_t lock;                 /**< Serializes the conversions and the registrations. */
+    StaticSemaphore_t lock_buffer;          /**< Storage of the mutex, it is never deleted. */
+} adc_unit_state_t;
+
+static adc_unit_state_t s_unit = {0};
+static portMUX_TYPE s_unit_lock_init = portMUX_INITIALIZER_UNLOCKED;
+
+static bool adc_calibration_init(adc_unit_t unit, adc_atten_t atten, adc_cali_handle_t *out_handle, 
+                                 bool *out_curve_fitting);
+static void adc_calibration_deinit(adc_cali_handle_t handle, bool curve_fitting);
+
+static int find_channel(adc_channel_t channel)
+{
+    for (size_t i = 0; i < s_unit.channel_count; i++) {
+        if (s_unit.channels[i] == channel) {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+static esp_err_t unit_acquire(void)
+{
+    esp_err_t err = ESP_OK;
+
+#if CONFIG_THERMISTOR_ADC_MODE_CONTINUOUS
+    if (s_unit.cont_h == NULL) {
+        err = thermistor_continuous_new(&s_unit.cont_h);
+    }
+#else
+    if (s_unit.oneshot_h == NULL) {
+        adc_oneshot_unit_init_cfg_t init_config = {
+            .unit_id = ADC_UNIT_1,
+        };
+
+        err = adc_oneshot_new_unit(&init_config, &s_unit.oneshot_h);
+    }
+#endif
+
+    return err;
+}
+
+static void unit_release(void)
+{
+    if (s_unit.cont_h != NULL) {
+        if (s_unit.running) {
+            adc_continuous_stop(s_unit.cont_h);
+            s_unit.running = false;
+        }
+        adc_continuous_deinit(s_unit.cont_h);
+        s_unit.cont_h = NULL;
+    }
+
+    if (s_unit.oneshot_h != NULL) {
+        adc_oneshot_del_unit(s_unit.oneshot_h);
+        s_unit.oneshot_h = NULL;
+    }
+}
+
+/**
+ * @brief Rebuild the continuous pattern with the registered channels, with the unit locked.
+ */
+static esp_err_t unit_restart(void)
+{
+    esp_err_t err = ESP_OK;
+
+    if (s_unit.running) {
+        adc_continuous_stop(s_unit.cont_h);
+        s_unit.running = false;
+    }
+
+    if (s_unit.channel_count > 0) {
+        err = thermistor_continuous_start(s_unit.cont_h, s_unit.channels, 
+                                          s_unit.attens, s_unit.channel_count);
+        s_unit.running = (err == ESP_OK);
+    }
+
+    return err;
+}
+
+/**
+ * @brief Unregister a channel, with the unit locked.
+ */
+static esp_err_t remove_channel(adc_channel_t channel)
+{
+    int index = find_channel(channel);
+
+    if (index < 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    if (--s_unit.users[index] > 0) {
+        return ESP_OK;
+    }
+
+    s_unit.channel_count--;
+    for (size_t i = index; i < s_unit.channel_count; i++) {
+        s_unit.channels[i] = s_unit.channels[i + 1];
+        s_unit.attens[i] = s_unit.attens[i + 1];
+        s_unit.users[i] = s_unit.users[i + 1];
+        s_unit.shared[i] = s_unit.shared[i + 1];
+    }
+
+    if (s_unit.channel_count == 0) {
+        unit_release();
+    } else if (s_unit.cont_h != NULL) {
+        return unit_restart();
+    }
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Register a new channel, shared or not, with the unit locked.
+ */
+static esp_err_t add_channel(adc_channel_t channel, adc_atten_t atten, bool shared)
+{
+    if (s_unit.channel_count >= MAX_CHANNELS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = unit_acquire();
+
+    if (err == ESP_OK) {
+        s_unit.channels[s_unit.channel_count] = channel;
+        s_unit.attens[s_unit.channel_count] = atten;
+        s_unit.users[s_unit.channel_count] = 1;
+        s_unit.shared[s_unit.channel_count] = shared;
+        s_unit.channel_count++;
+
+#if CONFIG_THERMISTOR_ADC_MODE_CONTINUOUS
+        err = unit_restart();
+#else
+        adc_oneshot_chan_cfg_t config = {
+                    .bitwidth = ADC_BITWIDTH_12, 
+                    .atten = atten,
+        };
+        
+        err = adc_oneshot_config_channel(s_unit.oneshot_h, channel, &config);
+#endif
+        
+        if (err != ESP_OK) {
+            remove_channel(channel);
+        }
+    }
+
+    return err;
+}
+
+esp_err_t thermistor_adc_add_channel(adc_channel_t channel, adc_atten_t atten,
+                                     adc_oneshot_unit_handle_t* out_oneshot,
+                                     adc_continuous_handle_t* out_cont)
+{
+    esp_err_t err = ESP_ERR_INVALID_STATE;
+
+    thermistor_adc_lock();
+
+    if (find_channel(channel) >= 0) {
+        ESP_LOGE(TAG, "channel %d already in use", channel);
+    } else {
+        err = add_channel(channel, atten, false);
+    }
+
+    *out_oneshot = s_unit.oneshot_h;
+    *out_cont = s_unit.cont_h;
+
+    thermistor_adc_unlock();
+
+    return err;
+}
+
+esp_err_t thermistor_adc_add_shared_channel(adc_channel_t channel, adc_atten_t atten)
+{
+    esp_err_t err = ESP_OK;
+
+    thermistor_adc_lock();
+
+    int index = find_channel(channel);
+
+    if (index < 0) {
+        err = add_channel(channel, atten, true);
+    } else if (!s_unit.shared[index] || (s_unit.attens[index] != atten)) {
+        ESP_LOGE(TAG, "channel %d already in use", channel);
+        err = ESP_ERR_INVALID_STATE;
+    } else {
+        s_unit.users[index]++;
+    }
+
+    thermistor_adc_unlock();
+
+    return err;
+}
+
+esp_err_t thermistor_adc_remove_channel(adc_channel_t channel)
+{
+    thermistor_adc_lock();
+    esp_err_t err = remove_channel(channel);
+    thermistor_adc_unlock();
+
+    return err;
+}
+
+bool thermistor_adc_is_exclusive(adc_channel_t channel)
+{
+    thermistor_adc_lock();
+
+    int index = find_channel(channel);
+    bool exclusive = (index == 0) && (s_unit.channel_count == 1) && (s_unit.users[index] == 1);
+
+    thermistor_adc_unlock();
+
+    return exclusive;
+}
+
+esp_err_t thermistor_adc_set_atten(adc_channel_t channel, adc_atten_t atten)
+{
+#if CONFIG_THERMISTOR_ADC_MODE_CONTINUOUS
+    // Changing the pattern restarts the conversions of all the channels.
+    return ESP_ERR_NOT_SUPPORTED;
+#else
+    esp_err_t err = ESP_OK;
+
+    thermistor_adc_lock();
+
+    int index = find_channel(channel);
+
+    if (index < 0) {
+        err = ESP_ERR_NOT_FOUND;
+    } else if (s_unit.shared[index]) {
+        err = ESP_ERR_INVALID_STATE;
+    } else if (s_unit.attens[index] != atten) {
+        adc_oneshot_chan_cfg_t config = {
+                    .bitwidth = ADC_BITWIDTH_12, 
+                    .atten = atten,
+        };
+
+        err = adc_oneshot_config_channel(s_unit.oneshot_h, channel, &config);
+        if (err == ESP_OK) {
+            s_unit.attens[index] = atten;
+        }
+    }
+
+    thermistor_adc_unlock();
+
+    return err;
+#endif
+}
+
+bool thermistor_adc_get_calibration(adc_atten_t atten, adc_cali_handle_t* out_handle)
+{
+    cali_entry_t* entry = &s_unit.cali[atten];
+
+    thermistor_adc_lock();
+
+    if (entry->ref_count++ == 0) {
+        entry->calibrated = adc_calibration_init(ADC_UNIT_1, atten, &entry->handle, 
+                                                 &entry->curve_fitting);
+    }
+
+    *out_handle = entry->handle;
+    bool calibrated = entry->calibrated;
+
+    thermistor_adc_unlock();
+
+    return calibrated;
+}
+
+void thermistor_adc_put_calibration(adc_atten_t atten)
+{
+    cali_entry_t* entry = &s_unit.cali[atten];
+
+    thermistor_adc_lock();
+
+    if ((entry->ref_count > 0) && (--entry->ref_count == 0)) {
+        if (entry->calibrated) {
+            adc_calibration_deinit(entry->handle, entry->curve_fitting);
+        }
+        entry->handle = NULL;
+        entry->calibrated = false;
+        entry->curve_fitting = false;
+    }
+
+    thermistor_adc_unlock();
+}
+
+void thermistor_adc_lock(void)
+{
+    // The mutex is created by the first user, whatever its task.
+    if (s_unit.lock == NULL) {
+        portENTER_CRITICAL(&s_unit_lock_init);
+        if (s_unit.lock == NULL) {
+            s_unit.lock = xSemaphoreCreateMutexStatic(&s_unit.lock_buffer);
+        }
+        portEXIT_CRITICAL(&s_unit_lock_init);
+    }
+
+    xSemaphoreTake(s_unit.lock, portMAX_DELAY);
+}
+
+void thermistor_adc_unlock(void)
+{
+    xSemaphoreGive(s_unit.lock);
+}
+
+esp_err_t thermistor_adc_scan(const adc_channel_t* channels, size_t count, 
+                              uint32_t samples, int* out_raw)
+{
+    if ((samples == 0) || (count == 0) || (count > MAX_CHANNELS)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = ESP_OK;
+
+    thermistor_adc_lock();
+
+#if CONFIG_THERMISTOR_ADC_MODE_CONTINUOUS
+    err = thermistor_continuous_read_raw(s_unit.cont_h, channels, count, samples, out_raw);
+#else
+    // 4096 * samples fits in 32 bits for any practical burst, so the 
+    // integer sum is exact.
+    uint32_t sum[MAX_CHANNELS] = {0};
+    int adc_raw = 0;
+
+    for (uint32_t i = 0; (err == ESP_OK) && (i < samples); i++) {
+        for (size_t ch = 0; (err == ESP_OK) && (ch < count); ch++) {
+            err = adc_oneshot_read(s_unit.oneshot_h, channels[ch], &adc_raw);
+            sum[ch] += adc_raw;
+        }
+    }
+
+    for (size_t ch = 0; (err == ESP_OK) && (ch < count); ch++) {
+        out_raw[ch] = (int)thermistor_adc_average(sum[ch], samples);
+    }
+#endif
+
+    thermistor_adc_unlock();
+
+    return err;
+}
+
+static bool adc_calibration_init(adc_unit_t unit, adc_atten_t atten, adc_cali_handle_t *out_handle, 
+                                 bool *out_curve_fitting)
+{
+    adc_cali_handle_t handle = NULL;
+    esp_err_t ret = ESP_FAIL;
+    bool calibrated = false;
+
+    *out_curve_fitting = false;
+
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+    if (!calibrated) {
+        ESP_LOGI(TAG, "calibration scheme version is %s", "Curve Fitting");
+        adc_cali_curve_fitting_config_t cali_config = {
+            .unit_id = unit,
+            .atten = atten,
+            .bitwidth = ADC_BITWIDTH_DEFAULT,
+        };
+        ret = adc_cali_create_scheme_curve_fitting(&cali_config, &handle);
+        if (ret == ESP_OK) {
+            calibrated = true;
+            *out_curve_fitting = true;
+        }
+    }
+#endif
+
+#if ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
+    if (!calibrated) {
+        ESP_LOGI(TAG, "calibration scheme version is %s", "Line Fitting");
+        adc_cali_line_fitting_config_t cali_config = {
+            .unit_id = unit,
+            .atten = atten,
+            .bitwidth = ADC_BITWIDTH_DEFAULT,
+        };
+        ret = adc_cali_create_scheme_line_fitting(&cali_config, &handle);
+        if (ret == ESP_OK) {
+            calibrated = true;
+        }
+    }
+#endif
+
+    *out_handle = handle;
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "Calibration Success");
+    } else if (ret == ESP_ERR_NOT_SUPPORTED || !calibrated) {
+        ESP_LOGW(TAG, "eFuse not burnt, skip software calibration");
+    } else {
+        ESP_LOGE(TAG, "Invalid arg or no memory");
+    }
+
+    return calibrated;
+}
+
+static void adc_calibration_deinit(adc_cali_handle_t handle, bool curve_fitting)
+{
+    // Each scheme is deleted by its own function, even if the target supports both.
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+    if (curve_fitting) {
+        adc_cali_delete_scheme_curve_fitting(handle);
+        return;
+    }
+#endif
+
+#if ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
+    if (!curve_fitting) {
+        adc_cali_delete_scheme_line_fitting(handle);
+    }
+#endif
+}
@@ -0,0 +1,199 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_alloc.c
+ * @brief Heap or static arena allocation of the tables of the thermistor driver.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "esp_err.h"
+
+#include "thermistor.h"
+#include "thermistor_alloc.h"
+
+#include "sdkconfig.h"
+
+#include "esp_log.h"
+static const char* TAG = "drv_thr_alloc";
+
+#if CONFIG_THERMISTOR_STATIC_ALLOCATION
+
+#define BLOCK_ALIGN     8
+#define BLOCK_FREE      0x80000000u     // Flag of the size of a freed block.
+#define NO_BLOCK        UINT32_MAX
+
+/**
+ * @brief Header that precedes each block of the arena.
+ */
+typedef struct {
+    uint32_t prev;                  /**< Offset of the previous table, NO_BLOCK for the first one. */
+    uint32_t size;                  /**< Bytes of the block with the header, and BLOCK_FREE. */
+} block_t;
+
+static uint8_t s_arena[CONFIG_THERMISTOR_ARENA_SIZE] __attribute__((aligned(BLOCK_ALIGN)));
+static uint32_t s_used = 0;                                 // End of the tables.
+static uint32_t s_top = NO_BLOCK;                           // Offset of the last table.
+static uint32_t s_scratch = CONFIG_THERMISTOR_ARENA_SIZE;   // Start of the scratch buffers.
+static uint32_t s_peak = 0;
+
+static block_t* block_at(uint32_t offset)
+{
+    return (block_t*)&s_arena[offset];
+}
+
+/**
+ * @brief Bytes of a block of size bytes with its header, 0 if it doesn't fit.
+ */
+static uint32_t block_size(size_t size)
+{
+    size_t total = sizeof(block_t) + ((size + BLOCK_ALIGN - 1) & ~(size_t)(BLOCK_ALIGN - 1));
+
+    if (total > (s_scratch - s_used)) {
+        ESP_LOGE(TAG, "arena exhausted, %u bytes requested and %u free", 
+                 (unsigned)size, (unsigned)(s_scratch - s_used));
+        return 0;
+    }
+
+    return (uint32_t)total;
+}
+
+static void update_peak(void)
+{
+    uint32_t in_use = s_used + (CONFIG_THERMISTOR_ARENA_SIZE - s_scratch);
+
+    if (in_use > s_peak) {
+        s_peak = in_use;
+    }
+}
+
+void* thermistor_alloc(size_t size)
+{
+    uint32_t total = block_size(size);
+
+    if (total == 0) {
+        return NULL;
+    }
+
+    block_t* block = block_at(s_used);
+
+    block->prev = s_top;
+    block->size = total;
+    s_top = s_used;
+    s_used += total;
+    update_peak();
+
+    return block + 1;
+}
+
+void thermistor_free(void* ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+
+    ((block_t*)ptr - 1)->size |= BLOCK_FREE;
+
+    while ((s_top != NO_BLOCK) && (block_at(s_top)->size & BLOCK_FREE)) {
+        s_used = s_top;
+        s_top = block_at(s_top)->prev;
+    }
+}
+
+void* thermistor_scratch_alloc(size_t size)
+{
+    uint32_t total = block_size(size);
+
+    if (total == 0) {
+        return NULL;
+    }
+
+    s_scratch -= total;
+    block_at(s_scratch)->size = total;
+    update_peak();
+
+    return block_at(s_scratch) + 1;
+}
+
+void thermistor_scratch_free(void* ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+
+    ((block_t*)ptr - 1)->size |= BLOCK_FREE;
+
+    // The scratch buffers are contiguous, the lowest one is the last allocated.
+    while ((s_scratch < CONFIG_THERMISTOR_ARENA_SIZE) && (block_at(s_scratch)->size & BLOCK_FREE)) {
+        s_scratch += block_at(s_scratch)->size & ~BLOCK_FREE;
+    }
+}
+
+esp_err_t thermistor_get_arena_usage(size_t* used, size_t* peak)
+{
+    *used = s_used + (CONFIG_THERMISTOR_ARENA_SIZE - s_scratch);
+    *peak = s_peak;
+
+    return ESP_OK;
+}
+
+#else
+
+void* thermistor_alloc(size_t size)
+{
+    void* ptr = malloc(size);
+
+    if (ptr == NULL) {
+        ESP_LOGE(TAG, "no memory for a block of %u bytes", (unsigned)size);
+    }
+
+    return ptr;
+}
+
+void thermistor_free(void* ptr)
+{
+    free(ptr);
+}
+
+void* thermistor_scratch_alloc(size_t size)
+{
+    return thermistor_alloc(size);
+}
+
+void thermistor_scratch_free(void* ptr)
+{
+    free(ptr);
+}
+
+esp_err_t thermistor_get_arena_usage(size_t* used, size_t* peak)
+{
+    *used = 0;
+    *peak = 0;
+
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
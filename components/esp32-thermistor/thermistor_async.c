@@ -0,0 +1,164 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_async.c
+ * @brief Asynchronous readings of thermistor component.
+ *
+ * The requests are queued to a driver task created on the first use, which 
+ * performs the burst, publishes the reading and signals the completion.
+ */
+
+#include "thermistor.h"
+#include "thermistor_priv.h"
+
+#include "freertos/queue.h"
+
+#include "sdkconfig.h"
+
+#include "esp_log.h"
+static const char* TAG = "drv_thr_async";
+
+#define QUEUE_LENGTH    THERMISTOR_GROUP_MAX    // One pending request per thermistor.
+
+enum {
+    WORKER_NONE = 0,
+    WORKER_CREATING,
+    WORKER_READY,
+};
+
+typedef struct {
+    thermistor_handle_t* th;
+    thermistor_async_t done;
+} async_request_t;
+
+static QueueHandle_t s_queue = NULL;
+static uint32_t s_worker_state = WORKER_NONE;
+
+#if CONFIG_THERMISTOR_STATIC_ALLOCATION
+static StaticQueue_t s_queue_buffer;
+static uint8_t s_queue_storage[QUEUE_LENGTH * sizeof(async_request_t)];
+static StaticTask_t s_task_buffer;
+static StackType_t s_task_stack[CONFIG_THERMISTOR_TASK_STACK_SIZE];
+#endif
+
+static void async_task(void* arg)
+{
+    async_request_t request;
+
+    while (1) {
+        xQueueReceive(s_queue, &request, portMAX_DELAY);
+        
+        thermistor_handle_t* th = request.th;
+        thermistor_reading_t reading;
+
+        thermistor_acquire(th, &reading);
+        thermistor_publish(th, &reading);
+
+        if (request.done.callback != NULL) {
+            request.done.callback(th, &reading, request.done.arg);
+        }
+
+        if (request.done.notify_task != NULL) {
+            xTaskNotifyGive(request.done.notify_task);
+        }
+
+        if (request.done.event_group != NULL) {
+            xEventGroupSetBits(request.done.event_group, request.done.event_bits);
+        }
+
+        // Released after the completion, so the waiter can't be signaled by a newer request.
+        __atomic_store_n(&th->async_pending, false, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * @brief Create the queue and the driver task, only once.
+ */
+static esp_err_t worker_start(void)
+{
+    uint32_t expected = WORKER_NONE;
+
+    if (__atomic_compare_exchange_n(&s_worker_state, &expected, WORKER_CREATING, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+#if CONFIG_THERMISTOR_STATIC_ALLOCATION
+        // The objects are never deleted, the static creation can't fail.
+        s_queue = xQueueCreateStatic(QUEUE_LENGTH, sizeof(async_request_t), 
+                                     s_queue_storage, &s_queue_buffer);
+        xTaskCreateStatic(async_task, "thermistor_async", CONFIG_THERMISTOR_TASK_STACK_SIZE, NULL,
+                          CONFIG_THERMISTOR_TASK_PRIORITY, s_task_stack, &s_task_buffer);
+#else
+        s_queue = xQueueCreate(QUEUE_LENGTH, sizeof(async_request_t));
+        
+        if ((s_queue == NULL) || 
+            (xTaskCreate(async_task, "thermistor_async", CONFIG_THERMISTOR_TASK_STACK_SIZE, NULL,
+                         CONFIG_THERMISTOR_TASK_PRIORITY, NULL) != pdPASS)) {
+            ESP_LOGE(TAG, "no memory for the async task");
+            if (s_queue != NULL) {
+                vQueueDelete(s_queue);
+                s_queue = NULL;
+            }
+            __atomic_store_n(&s_worker_state, WORKER_NONE, __ATOMIC_RELEASE);
+            return ESP_ERR_NO_MEM;
+        }
+#endif
+        
+        __atomic_store_n(&s_worker_state, WORKER_READY, __ATOMIC_RELEASE);
+        return ESP_OK;
+    }
+
+    // Another task is creating the worker.
+    while ((expected = __atomic_load_n(&s_worker_state, __ATOMIC_ACQUIRE)) == WORKER_CREATING) {
+        vTaskDelay(1);
+    }
+
+    return (expected == WORKER_READY) ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t thermistor_read_async(thermistor_handle_t* th, const thermistor_async_t* done)
+{
+    if ((th->sampling_task != NULL) || 
+        __atomic_exchange_n(&th->async_pending, true, __ATOMIC_ACQ_REL)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t err = worker_start();
+
+    if (err == ESP_OK) {
+        async_request_t request = {
+            .th = th,
+            .done = *done,
+        };
+        
+        if (xQueueSend(s_queue, &request, 0) != pdTRUE) {
+            err = ESP_ERR_NO_MEM;
+        }
+    }
+
+    if (err != ESP_OK) {
+        th->async_pending = false;
+    }
+
+    return err;
+}
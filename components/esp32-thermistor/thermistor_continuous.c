@@ -0,0 +1,144 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_continuous.c
+ * @brief Continuous (DMA) ADC backend of thermistor component for ESP32.
+ */
+
+#include "thermistor_continuous.h"
+#include "thermistor_adc.h"
+
+#include "sdkconfig.h"
+
+#include "esp_log.h"
+static const char* TAG = "drv_thr_cont";
+
+#ifndef CONFIG_THERMISTOR_CONTINUOUS_SAMPLE_FREQ_HZ
+#define CONFIG_THERMISTOR_CONTINUOUS_SAMPLE_FREQ_HZ 20000
+#endif
+
+#define FRAME_CONVERSIONS   64          // Conversions delivered by each DMA frame.
+#define FRAME_SIZE          (FRAME_CONVERSIONS * SOC_ADC_DIGI_RESULT_BYTES)
+#define POOL_SIZE           (FRAME_SIZE * 4)
+#define READ_TIMEOUT_MS     100
+
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+#define ADC_OUTPUT_TYPE             ADC_DIGI_OUTPUT_FORMAT_TYPE1
+#define ADC_GET_CHANNEL(p_data)     ((p_data)->type1.channel)
+#define ADC_GET_DATA(p_data)        ((p_data)->type1.data)
+#else
+#define ADC_OUTPUT_TYPE             ADC_DIGI_OUTPUT_FORMAT_TYPE2
+#define ADC_GET_CHANNEL(p_data)     ((p_data)->type2.channel)
+#define ADC_GET_DATA(p_data)        ((p_data)->type2.data)
+#endif
+
+esp_err_t thermistor_continuous_new(adc_continuous_handle_t* out_handle)
+{
+    adc_continuous_handle_cfg_t handle_config = {
+        .max_store_buf_size = POOL_SIZE,
+        .conv_frame_size = FRAME_SIZE,
+    };
+
+    return adc_continuous_new_handle(&handle_config, out_handle);
+}
+
+esp_err_t thermistor_continuous_start(adc_continuous_handle_t handle, const adc_channel_t* channels,
+                                      const adc_atten_t* attens, size_t count)
+{
+    adc_digi_pattern_config_t pattern[SOC_ADC_PATT_LEN_MAX] = {0};
+
+    if ((count == 0) || (count > SOC_ADC_PATT_LEN_MAX)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        pattern[i].atten = attens[i];
+        pattern[i].channel = channels[i] & 0x7;
+        pattern[i].unit = ADC_UNIT_1;
+        pattern[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+    }
+
+    adc_continuous_config_t config = {
+        .pattern_num = count,
+        .adc_pattern = pattern,
+        .sample_freq_hz = CONFIG_THERMISTOR_CONTINUOUS_SAMPLE_FREQ_HZ,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = ADC_OUTPUT_TYPE,
+    };
+
+    esp_err_t err = adc_continuous_config(handle, &config);
+    
+    if (err == ESP_OK) {
+        err = adc_continuous_start(handle);
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "continuous mode setup failed: %s", esp_err_to_name(err));
+    }
+
+    return err;
+}
+
+esp_err_t thermistor_continuous_read_raw(adc_continuous_handle_t handle, const adc_channel_t* channels, 
+                                         size_t count, uint32_t samples, int* out_raw)
+{
+    uint8_t frame[FRAME_SIZE];
+    uint32_t sum[SOC_ADC_PATT_LEN_MAX] = {0};
+    uint32_t taken[SOC_ADC_PATT_LEN_MAX] = {0};
+    uint32_t length = 0;
+    size_t completed = 0;
+
+    if ((samples == 0) || (count == 0) || (count > SOC_ADC_PATT_LEN_MAX)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Discard the conversions stored since the previous reading.
+    esp_err_t err = adc_continuous_flush_pool(handle);
+
+    while ((err == ESP_OK) && (completed < count)) {
+        err = adc_continuous_read(handle, frame, sizeof(frame), &length, READ_TIMEOUT_MS);
+        
+        for (uint32_t i = 0; (err == ESP_OK) && (i < length); i += SOC_ADC_DIGI_RESULT_BYTES) {
+            adc_digi_output_data_t* p = (adc_digi_output_data_t*)&frame[i];
+            
+            for (size_t ch = 0; ch < count; ch++) {
+                if ((ADC_GET_CHANNEL(p) == channels[ch]) && (taken[ch] < samples)) {
+                    sum[ch] += ADC_GET_DATA(p);
+                    
+                    if (++taken[ch] == samples) {
+                        completed++;
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    for (size_t ch = 0; (err == ESP_OK) && (ch < count); ch++) {
+        out_raw[ch] = (int)thermistor_adc_average(sum[ch], samples);
+    }
+
+    return err;
+}
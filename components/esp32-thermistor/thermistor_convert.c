@@ -0,0 +1,138 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_convert.c
+ * @brief Batch conversion of raw codes to temperature.
+ *
+ * Each model has its own loop, so the selection is outside the loops and the 
+ * loops are straight line code. The beta segments need a selection per code, 
+ * which is done with conditional moves.
+ */
+
+#include "thermistor_convert.h"
+
+#include <math.h>
+
+#define KELVIN  273.15f
+
+bool thermistor_convert_init(thermistor_convert_t* conv, float serial_resistance, float vsource,
+                             const thermistor_model_config_t* model, float mv_per_code, float offset_mv)
+{
+    if (!(serial_resistance > 0) || !(vsource > 0) || !(mv_per_code > 0)) {
+        return false;
+    }
+
+    conv->serial_resistance = serial_resistance;
+    conv->vsource = vsource;
+    conv->mv_per_code = mv_per_code;
+    conv->offset_mv = offset_mv;
+
+    return thermistor_model_prepare(&conv->coeffs, model);
+}
+
+/**
+ * @brief Resistance of the thermistor for a raw code, Rt = R1 * Vout / (Vs - Vout).
+ */
+static inline float code_to_resistance(const thermistor_convert_t* conv, uint16_t code)
+{
+    float vout = (code * conv->mv_per_code) + conv->offset_mv;
+
+    vout = fminf(fmaxf(vout, 0.5f), conv->vsource - 0.5f);
+
+    return (conv->serial_resistance * vout) / (conv->vsource - vout);
+}
+
+static void convert_beta(const thermistor_convert_t* conv, const uint16_t* restrict codes, 
+                         float* restrict out, size_t n)
+{
+    const float inv_t0 = conv->coeffs.beta[0].inv_t0;
+    const float inv_beta = conv->coeffs.beta[0].inv_beta;
+    const float ln_r0 = conv->coeffs.beta[0].ln_r0;
+
+    for (size_t i = 0; i < n; i++) {
+        float ln_r = logf(code_to_resistance(conv, codes[i]));
+
+        out[i] = (1.0f / (inv_t0 + (inv_beta * (ln_r - ln_r0)))) - KELVIN;
+    }
+}
+
+static void convert_steinhart_hart(const thermistor_convert_t* conv, const uint16_t* restrict codes, 
+                                   float* restrict out, size_t n)
+{
+    const float a = conv->coeffs.a;
+    const float b = conv->coeffs.b;
+    const float c = conv->coeffs.c;
+
+    for (size_t i = 0; i < n; i++) {
+        float ln_r = logf(code_to_resistance(conv, codes[i]));
+
+        out[i] = (1.0f / (a + (b * ln_r) + (c * ln_r * ln_r * ln_r))) - KELVIN;
+    }
+}
+
+static void convert_segments(const thermistor_convert_t* conv, const uint16_t* restrict codes, 
+                             float* restrict out, size_t n)
+{
+    const thermistor_beta_coeffs_t* beta = conv->coeffs.beta;
+    const uint8_t last = conv->coeffs.count - 1;
+
+    for (size_t i = 0; i < n; i++) {
+        float resistance = code_to_resistance(conv, codes[i]);
+        float ln_r = logf(resistance);
+        float inv_t0 = beta[last].inv_t0;
+        float inv_beta = beta[last].inv_beta;
+        float ln_r0 = beta[last].ln_r0;
+
+        // From the hottest to the coldest segment, the last match is the first 
+        // segment with resistance >= r_min, as in thermistor_model_celsius().
+        for (int s = last - 1; s >= 0; s--) {
+            bool match = resistance >= beta[s].r_min;
+
+            inv_t0 = match ? beta[s].inv_t0 : inv_t0;
+            inv_beta = match ? beta[s].inv_beta : inv_beta;
+            ln_r0 = match ? beta[s].ln_r0 : ln_r0;
+        }
+
+        out[i] = (1.0f / (inv_t0 + (inv_beta * (ln_r - ln_r0)))) - KELVIN;
+    }
+}
+
+void thermistor_convert_batch(const thermistor_convert_t* conv, const uint16_t* codes, 
+                              float* out, size_t n)
+{
+    switch (conv->coeffs.model) {
+    case THERMISTOR_MODEL_BETA:
+        convert_beta(conv, codes, out, n);
+        break;
+
+    case THERMISTOR_MODEL_STEINHART_HART:
+        convert_steinhart_hart(conv, codes, out, n);
+        break;
+
+    case THERMISTOR_MODEL_BETA_SEGMENTS:
+        convert_segments(conv, codes, out, n);
+        break;
+    }
+}
@@ -0,0 +1,190 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_filter.c
+ * @brief Streaming filters of thermistor component.
+ */
+
+#include "thermistor_filter.h"
+
+#include <string.h>
+
+#define EMA_FRAC_BITS   16
+
+bool thermistor_filter_init(thermistor_filter_t* filter, const thermistor_filter_config_t* config)
+{
+    if (config == NULL) {
+        memset(filter, 0, sizeof(*filter));
+        return true;
+    }
+
+    switch (config->type) {
+    case THERMISTOR_FILTER_NONE:
+        break;
+
+    case THERMISTOR_FILTER_EMA:
+        if ((config->ema_shift < 1) || (config->ema_shift > 8)) {
+            return false;
+        }
+        break;
+
+    case THERMISTOR_FILTER_MEDIAN:
+        if ((config->median_window < 3) || (config->median_window > THERMISTOR_FILTER_MEDIAN_MAX) ||
+            ((config->median_window & 1) == 0)) {
+            return false;
+        }
+        break;
+
+    case THERMISTOR_FILTER_CIC:
+        // The integrators wrap modulo 2^32, which is exact while the 12 bits 
+        // of the code plus the gain fit in the register.
+        if ((config->cic_order < 1) || (config->cic_order > THERMISTOR_FILTER_CIC_MAX_ORDER) ||
+            ((config->cic_order * config->cic_decimation_shift) > THERMISTOR_FILTER_CIC_MAX_GAIN)) {
+            return false;
+        }
+        break;
+
+    default:
+        return false;
+    }
+
+    memset(filter, 0, sizeof(*filter));
+    filter->config = *config;
+
+    return true;
+}
+
+void thermistor_filter_reset(thermistor_filter_t* filter)
+{
+    thermistor_filter_config_t config = filter->config;
+
+    // The configuration was validated when the filter was initialized.
+    thermistor_filter_init(filter, &config);
+}
+
+static uint16_t ema_update(thermistor_filter_t* filter, uint16_t raw)
+{
+    int32_t sample = (int32_t)raw << EMA_FRAC_BITS;
+
+    if (!filter->primed) {
+        filter->ema = sample;
+    } else {
+        filter->ema += (sample - filter->ema) >> filter->config.ema_shift;
+    }
+
+    // Round to the nearest code.
+    return (uint16_t)((filter->ema + (1 << (EMA_FRAC_BITS - 1))) >> EMA_FRAC_BITS);
+}
+
+static uint16_t median_update(thermistor_filter_t* filter, uint16_t raw)
+{
+    uint16_t sorted[THERMISTOR_FILTER_MEDIAN_MAX];
+    uint8_t count;
+
+    filter->median[filter->median_pos] = raw;
+    filter->median_pos = (filter->median_pos + 1) % filter->config.median_window;
+    
+    if (filter->median_count < filter->config.median_window) {
+        filter->median_count++;
+    }
+
+    // Insertion sort, the window is small.
+    count = filter->median_count;
+    for (uint8_t i = 0; i < count; i++) {
+        uint16_t value = filter->median[i];
+        int j = i - 1;
+        
+        while ((j >= 0) && (sorted[j] > value)) {
+            sorted[j + 1] = sorted[j];
+            j--;
+        }
+        sorted[j + 1] = value;
+    }
+
+    return sorted[count / 2];
+}
+
+static uint16_t cic_update(thermistor_filter_t* filter, uint16_t raw)
+{
+    uint8_t order = filter->config.cic_order;
+    uint32_t value = raw;
+
+    for (uint8_t i = 0; i < order; i++) {
+        filter->integrator[i] += value;
+        value = filter->integrator[i];
+    }
+
+    bool settled = (filter->cic_outputs >= order);
+
+    if (++filter->phase < (1UL << filter->config.cic_decimation_shift)) {
+        // Between decimations hold the last output.
+        return settled ? filter->output : raw;
+    }
+
+    filter->phase = 0;
+
+    for (uint8_t i = 0; i < order; i++) {
+        uint32_t delayed = filter->comb[i];
+        
+        filter->comb[i] = value;
+        value -= delayed;
+    }
+
+    // The combs start at 0, so the first order outputs are a transient and 
+    // the code passes through until they settle.
+    if (!settled) {
+        filter->cic_outputs++;
+        return raw;
+    }
+
+    return (uint16_t)(value >> (order * filter->config.cic_decimation_shift));
+}
+
+uint16_t thermistor_filter_update(thermistor_filter_t* filter, uint16_t raw)
+{
+    uint16_t output = raw;
+
+    switch (filter->config.type) {
+    case THERMISTOR_FILTER_EMA:
+        output = ema_update(filter, raw);
+        break;
+
+    case THERMISTOR_FILTER_MEDIAN:
+        output = median_update(filter, raw);
+        break;
+
+    case THERMISTOR_FILTER_CIC:
+        output = cic_update(filter, raw);
+        break;
+
+    default:
+        break;
+    }
+
+    filter->primed = true;
+    filter->output = output;
+
+    return output;
+}
@@ -0,0 +1,154 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_model.c
+ * @brief Resistance to temperature models of thermistor component.
+ */
+
+#include "thermistor_model.h"
+#include "thermistor_precision.h"
+
+#define KELVIN  273.15
+
+/**
+ * @brief Calculate the invariants of a beta equation.
+ */
+static bool beta_prepare(thermistor_beta_coeffs_t* coeffs, const thermistor_beta_t* beta)
+{
+    if ((beta->beta_val <= 0) || (beta->nominal_resistance <= 0)) {
+        return false;
+    }
+
+    coeffs->inv_t0 = 1.0 / (beta->nominal_temperature + KELVIN);
+    coeffs->inv_beta = 1.0 / beta->beta_val;
+    coeffs->ln_r0 = log(beta->nominal_resistance);
+    coeffs->r_min = 0;
+
+    return true;
+}
+
+bool thermistor_model_prepare(thermistor_coeffs_t* coeffs, const thermistor_model_config_t* config)
+{
+    bool valid = false;
+
+    coeffs->model = config->model;
+    coeffs->count = 0;
+
+    switch (config->model) {
+    case THERMISTOR_MODEL_BETA:
+        coeffs->count = 1;
+        valid = beta_prepare(&coeffs->beta[0], &config->beta);
+        break;
+
+    case THERMISTOR_MODEL_STEINHART_HART:
+        coeffs->a = config->steinhart_hart.a;
+        coeffs->b = config->steinhart_hart.b;
+        coeffs->c = config->steinhart_hart.c;
+        valid = (coeffs->b != 0);
+        break;
+
+    case THERMISTOR_MODEL_BETA_SEGMENTS:
+        if ((config->segmented.count == 0) || 
+            (config->segmented.count > THERMISTOR_MODEL_MAX_SEGMENTS)) {
+            break;
+        }
+
+        valid = true;
+        coeffs->count = config->segmented.count;
+        
+        for (size_t i = 0; valid && (i < config->segmented.count); i++) {
+            const thermistor_segment_t* segment = &config->segmented.segments[i];
+            
+            valid = beta_prepare(&coeffs->beta[i], &segment->beta);
+            
+            if (valid && (i < (config->segmented.count - 1))) {
+                // The segments are selected by resistance, which decreases with 
+                // the temperature: R = R0 * e^(B * (1/T - 1/T0)).
+                double inv_t = 1.0 / (segment->max_temperature + KELVIN);
+                
+                coeffs->beta[i].r_min = segment->beta.nominal_resistance * 
+                                        exp(segment->beta.beta_val * (inv_t - coeffs->beta[i].inv_t0));
+                valid = (i == 0) || (coeffs->beta[i].r_min < coeffs->beta[i - 1].r_min);
+            }
+        }
+        break;
+    }
+
+    return valid;
+}
+
+float thermistor_model_celsius(const thermistor_coeffs_t* coeffs, float resistance)
+{
+    thermistor_coeff_t ln_r = MATH_LOG(resistance);
+    thermistor_coeff_t inv_t;
+
+    if (coeffs->model == THERMISTOR_MODEL_STEINHART_HART) {
+        inv_t = coeffs->a + (coeffs->b * ln_r) + (coeffs->c * ln_r * ln_r * ln_r);
+    } else {
+        const thermistor_beta_coeffs_t* beta = &coeffs->beta[0];
+        
+        // Segments are sorted by temperature, the last one has no upper limit.
+        for (uint8_t i = 0; i < (coeffs->count - 1); i++, beta++) {
+            if (resistance >= beta->r_min) {
+                break;
+            }
+        }
+
+        inv_t = beta->inv_t0 + (beta->inv_beta * (ln_r - beta->ln_r0));
+    }
+
+    return (MATH_CONST(1.0) / inv_t) - MATH_CONST(273.15);
+}
+
+float thermistor_model_resistance(const thermistor_coeffs_t* coeffs, float celsius)
+{
+    double inv_t = 1.0 / (celsius + KELVIN);
+    double ln_r;
+
+    if (coeffs->model == THERMISTOR_MODEL_STEINHART_HART) {
+        if (coeffs->c == 0) {
+            ln_r = (inv_t - coeffs->a) / coeffs->b;
+        } else {
+            // C * x^3 + B * x + (A - 1/T) = 0, solved with the Cardano formula.
+            double p = (double)coeffs->b / coeffs->c;
+            double q = (coeffs->a - inv_t) / coeffs->c;
+            double s = sqrt((q * q / 4) + (p * p * p / 27));
+
+            ln_r = cbrt((-q / 2) + s) + cbrt((-q / 2) - s);
+        }
+    } else {
+        const thermistor_beta_coeffs_t* beta = &coeffs->beta[0];
+
+        for (uint8_t i = 0; ; i++, beta++) {
+            ln_r = beta->ln_r0 + ((inv_t - beta->inv_t0) / beta->inv_beta);
+            
+            if ((i >= (coeffs->count - 1)) || (exp(ln_r) >= beta->r_min)) {
+                break;
+            }
+        }
+    }
+
+    return exp(ln_r);
+}
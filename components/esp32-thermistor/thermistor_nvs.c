@@ -0,0 +1,326 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_nvs.c
+ * @brief Cache of the calibration and the lookup table of each thermistor in NVS.
+ *
+ * Each channel has a blob with a header, the raw code to mV table of the 
+ * calibration scheme and the lookup table (when it is not the ROM table). The 
+ * header stores a CRC of the parameters of the thermistor, so a blob of other 
+ * parameters is ignored, and a CRC of the whole blob.
+ */
+
+#include "thermistor.h"
+#include "thermistor_priv.h"
+#include "thermistor_alloc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sdkconfig.h"
+
+#if CONFIG_THERMISTOR_NVS_CACHE
+
+#include "nvs.h"
+#include "esp_rom_crc.h"
+
+#include "esp_log.h"
+static const char* TAG = "drv_thr_nvs";
+
+#ifndef CONFIG_THERMISTOR_NVS_NAMESPACE
+#define CONFIG_THERMISTOR_NVS_NAMESPACE "thermistor"
+#endif
+
+#ifndef CONFIG_THERMISTOR_LUT_STEP_SHIFT
+#define CONFIG_THERMISTOR_LUT_STEP_SHIFT 4
+#endif
+
+#define BLOB_MAGIC      0x43524854  // "THRC"
+
+typedef struct
+{
+    uint32_t magic;                 /**< BLOB_MAGIC. */
+    uint32_t params_crc;            /**< CRC of the parameters the tables were built with. */
+    float gain;                     /**< User gain correction. */
+    int32_t offset_mv;              /**< User offset correction in mV. */
+    uint16_t cali_size;             /**< Entries of the calibration table. */
+    uint16_t lut_size;              /**< Entries of the lookup table, 0 if it is not stored. */
+    uint8_t cali_shift;             /**< Log2 of the step in raw codes of the calibration table. */
+    uint8_t lut_shift;              /**< Log2 of the step in mV of the lookup table. */
+    uint16_t reserved;
+    uint32_t crc;                   /**< CRC of the blob, calculated with this field in 0. */
+} blob_header_t;
+
+static void channel_key(const thermistor_handle_t* th, char* key, size_t len)
+{
+    snprintf(key, len, "ch%u", (unsigned)th->channel);
+}
+
+/**
+ * @brief CRC of the parameters that the tables depend on.
+ */
+static uint32_t params_crc(const thermistor_handle_t* th)
+{
+    // Fields are copied one by one, so the padding of the structures is not hashed.
+    thermistor_coeff_t values[5 + (4 * THERMISTOR_MODEL_MAX_SEGMENTS)];
+    uint32_t ids[4] = {
+        th->coeffs->model, 
+        th->coeffs->count, 
+        ADC_ATTEN_DB_12,
+#if CONFIG_THERMISTOR_LUT
+        CONFIG_THERMISTOR_LUT_STEP_SHIFT,
+#else
+        UINT32_MAX,
+#endif
+    };
+    size_t n = 0;
+
+    values[n++] = th->serial_resistance;
+    values[n++] = th->vsource;
+    values[n++] = th->coeffs->a;
+    values[n++] = th->coeffs->b;
+    values[n++] = th->coeffs->c;
+    for (uint8_t i = 0; (i < th->coeffs->count) && (i < THERMISTOR_MODEL_MAX_SEGMENTS); i++) {
+        values[n++] = th->coeffs->beta[i].inv_t0;
+        values[n++] = th->coeffs->beta[i].inv_beta;
+        values[n++] = th->coeffs->beta[i].ln_r0;
+        values[n++] = th->coeffs->beta[i].r_min;
+    }
+
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t*)ids, sizeof(ids));
+
+    return esp_rom_crc32_le(crc, (const uint8_t*)values, n * sizeof(values[0]));
+}
+
+esp_err_t thermistor_nvs_load(thermistor_handle_t* th)
+{
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    nvs_handle_t nvs;
+    size_t len = 0;
+
+    if (nvs_open(CONFIG_THERMISTOR_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    channel_key(th, key, sizeof(key));
+
+    esp_err_t err = nvs_get_blob(nvs, key, NULL, &len);
+    uint8_t* blob = NULL;
+
+    if ((err == ESP_OK) && (len >= sizeof(blob_header_t))) {
+        blob = thermistor_scratch_alloc(len);
+        err = (blob != NULL) ? nvs_get_blob(nvs, key, blob, &len) : ESP_ERR_NO_MEM;
+    } else {
+        err = ESP_ERR_NOT_FOUND;
+    }
+
+    nvs_close(nvs);
+
+    if (err != ESP_OK) {
+        thermistor_scratch_free(blob);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    blob_header_t header;
+    
+    memcpy(&header, blob, sizeof(header));
+
+    uint32_t crc = header.crc;
+    
+    header.crc = 0;
+    memcpy(blob, &header, sizeof(header));
+
+    size_t cali_bytes = header.cali_size * sizeof(uint16_t);
+    size_t lut_bytes = header.lut_size * sizeof(int16_t);
+
+    if ((header.magic != BLOB_MAGIC) ||
+        (len != sizeof(header) + cali_bytes + lut_bytes) ||
+        (esp_rom_crc32_le(0, blob, len) != crc) ||
+        (header.params_crc != params_crc(th)) ||
+        (header.cali_size != THERMISTOR_CALI_SIZE) ||
+        (header.cali_shift != THERMISTOR_CALI_SHIFT)) {
+        ESP_LOGW(TAG, "stored calibration of %s is not valid", key);
+        thermistor_scratch_free(blob);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    uint16_t* cali_table = thermistor_alloc(cali_bytes);
+
+    if (cali_table == NULL) {
+        thermistor_scratch_free(blob);
+        return ESP_ERR_NO_MEM;
+    }
+
+    memcpy(cali_table, blob + sizeof(header), cali_bytes);
+
+#if CONFIG_THERMISTOR_LUT
+    // The spare table is reserved too, as by thermistor_lut_build().
+    esp_err_t lut_err = ESP_OK;
+
+    if (lut_bytes != 0) {
+        int16_t* lut_table = thermistor_lut_reserve(th, header.lut_size, header.lut_shift);
+
+        if (lut_table != NULL) {
+            memcpy(lut_table, blob + sizeof(header) + cali_bytes, lut_bytes);
+        } else {
+            lut_err = ESP_ERR_NO_MEM;
+        }
+    } else {
+        // The ROM table was in use when the blob was stored.
+        lut_err = thermistor_lut_build(th);
+    }
+#endif
+
+    thermistor_scratch_free(blob);
+
+#if CONFIG_THERMISTOR_LUT
+    if (lut_err != ESP_OK) {
+        thermistor_free(cali_table);
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+
+    th->cali_table = cali_table;
+    th->cali_gain = header.gain;
+    th->cali_offset_mv = header.offset_mv;
+
+    ESP_LOGI(TAG, "calibration of %s loaded from NVS", key);
+
+    return ESP_OK;
+}
+
+esp_err_t thermistor_save_calibration(const thermistor_handle_t* th)
+{
+    if (!th->calibrated) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    const thermistor_lut_t* lut = th->lut;
+    bool store_lut = (lut != NULL) && lut->owned;
+    size_t cali_bytes = THERMISTOR_CALI_SIZE * sizeof(uint16_t);
+    size_t lut_bytes = store_lut ? lut->size * sizeof(int16_t) : 0;
+    size_t len = sizeof(blob_header_t) + cali_bytes + lut_bytes;
+    uint8_t* blob = thermistor_scratch_alloc(len);
+
+    if (blob == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    uint16_t* cali_table = (uint16_t*)(blob + sizeof(blob_header_t));
+    
+    for (uint32_t i = 0; i < THERMISTOR_CALI_SIZE; i++) {
+        int raw = i << THERMISTOR_CALI_SHIFT;
+        int voltage = 0;
+
+        if (raw >= (1 << SOC_ADC_RTC_MAX_BITWIDTH)) {
+            raw = (1 << SOC_ADC_RTC_MAX_BITWIDTH) - 1;
+        }
+
+        if (th->cali_table != NULL) {
+            // Loaded from NVS, the scheme was not created.
+            voltage = th->cali_table[i];
+        } else {
+            adc_cali_raw_to_voltage(th->adc_cali_h, raw, &voltage);
+        }
+
+        cali_table[i] = (uint16_t)voltage;
+    }
+
+    if (store_lut) {
+        memcpy(blob + sizeof(blob_header_t) + cali_bytes, lut->table, lut_bytes);
+    }
+
+    blob_header_t header = {
+        .magic = BLOB_MAGIC,
+        .params_crc = params_crc(th),
+        .gain = th->cali_gain,
+        .offset_mv = th->cali_offset_mv,
+        .cali_size = THERMISTOR_CALI_SIZE,
+        .lut_size = store_lut ? lut->size : 0,
+        .cali_shift = THERMISTOR_CALI_SHIFT,
+        .lut_shift = store_lut ? lut->shift : 0,
+        .crc = 0,
+    };
+
+    memcpy(blob, &header, sizeof(header));
+    header.crc = esp_rom_crc32_le(0, blob, len);
+    memcpy(blob, &header, sizeof(header));
+
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(CONFIG_THERMISTOR_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+
+    if (err == ESP_OK) {
+        channel_key(th, key, sizeof(key));
+        err = nvs_set_blob(nvs, key, blob, len);
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+
+    thermistor_scratch_free(blob);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "calibration not stored: %s", esp_err_to_name(err));
+    }
+
+    return err;
+}
+
+esp_err_t thermistor_erase_calibration(const thermistor_handle_t* th)
+{
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(CONFIG_THERMISTOR_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+
+    if (err == ESP_OK) {
+        channel_key(th, key, sizeof(key));
+        err = nvs_erase_key(nvs, key);
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            err = ESP_OK;
+        } else if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+
+    return err;
+}
+
+#else
+
+esp_err_t thermistor_save_calibration(const thermistor_handle_t* th)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t thermistor_erase_calibration(const thermistor_handle_t* th)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif /* CONFIG_THERMISTOR_NVS_CACHE */
@@ -0,0 +1,284 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_pipeline.c
+ * @brief Dual-core sampling pipeline of thermistor component.
+ *
+ * The acquisition task only performs the bursts and pushes the raw codes to 
+ * a single producer, single consumer queue, so it never waits for the 
+ * processing task. The processing task is the only one that writes the 
+ * filter, the alarms, the ring and the published readings of the handle.
+ */
+
+#include "thermistor.h"
+#include "thermistor_alloc.h"
+#include "thermistor_priv.h"
+#include "thermistor_spsc.h"
+
+#include "sdkconfig.h"
+
+#if CONFIG_THERMISTOR_PIPELINE
+
+#include <string.h>
+
+#include "esp_timer.h"
+
+#include "esp_log.h"
+static const char* TAG = "drv_thr_pipe";
+
+#if (CONFIG_THERMISTOR_PIPELINE_DEPTH & (CONFIG_THERMISTOR_PIPELINE_DEPTH - 1)) != 0
+#error "CONFIG_THERMISTOR_PIPELINE_DEPTH must be a power of two"
+#endif
+
+struct thermistor_pipeline
+{
+    thermistor_handle_t* th;
+    thermistor_pipeline_config_t config;
+    thermistor_spsc_t queue;
+    thermistor_spsc_item_t items[CONFIG_THERMISTOR_PIPELINE_DEPTH];
+    thermistor_reading_t batch[THERMISTOR_PIPELINE_MAX_BATCH];
+    TaskHandle_t acquisition_task;
+    TaskHandle_t processing_task;
+#if CONFIG_THERMISTOR_STATIC_ALLOCATION
+    thermistor_task_storage_t acquisition_storage;
+    thermistor_task_storage_t processing_storage;
+#endif
+};
+
+static void acquisition_task(void* arg)
+{
+    thermistor_pipeline_t* p = (thermistor_pipeline_t*)arg;
+    thermistor_handle_t* th = p->th;
+
+    while (1) {
+        uint32_t periods = 0;
+
+        // The timer of the handle adds one to the notification on each period.
+        xTaskNotifyWait(0, UINT32_MAX, &periods, portMAX_DELAY);
+
+        if (periods & THERMISTOR_TASK_STOP) {
+            break;
+        }
+
+        if (periods > 1) {
+            th->sampling_missed += periods - 1;
+        }
+
+        int adc_raw[2] = { 0, 0 };
+        thermistor_spsc_item_t item = {
+            .timestamp_us = esp_timer_get_time(),
+        };
+
+        if (thermistor_burst_raw(th, adc_raw) != ESP_OK) {
+            continue;
+        }
+
+        item.raw[0] = adc_raw[0];
+        item.raw[1] = adc_raw[1];
+
+        if (!thermistor_spsc_push(&p->queue, &item)) {
+            th->sampling_missed++;
+        }
+
+        if (thermistor_spsc_count(&p->queue) >= p->config.batch) {
+            xTaskNotifyGive(p->processing_task);
+        }
+    }
+
+    thermistor_task_exit(th, THERMISTOR_ACQUISITION_EXITED);
+}
+
+/**
+ * @brief Processes the queued bursts in batches, until the queue is empty.
+ */
+static void pipeline_drain(thermistor_pipeline_t* p)
+{
+    thermistor_handle_t* th = p->th;
+    size_t count;
+
+    do {
+        thermistor_spsc_item_t item;
+
+        count = 0;
+        while ((count < p->config.batch) && thermistor_spsc_pop(&p->queue, &item)) {
+            int adc_raw[2] = { item.raw[0], item.raw[1] };
+            thermistor_reading_t* reading = &p->batch[count++];
+
+            reading->timestamp_us = item.timestamp_us;
+            thermistor_process_raw(th, adc_raw, reading);
+        }
+
+        if (count > 0) {
+            thermistor_publish(th, &p->batch[count - 1]);
+            if (p->config.callback != NULL) {
+                p->config.callback(th, p->batch, count, p->config.arg);
+            }
+        }
+    } while (count == p->config.batch);
+}
+
+static void processing_task(void* arg)
+{
+    thermistor_pipeline_t* p = (thermistor_pipeline_t*)arg;
+
+    while (1) {
+        uint32_t notified = 0;
+
+        xTaskNotifyWait(0, UINT32_MAX, &notified, portMAX_DELAY);
+
+        // The stop arrives after the exit of the acquisition task, the rest of the queue is processed.
+        pipeline_drain(p);
+
+        if (notified & THERMISTOR_TASK_STOP) {
+            break;
+        }
+    }
+
+    thermistor_task_exit(p->th, THERMISTOR_PROCESSING_EXITED);
+}
+
+/**
+ * @brief Stop the tasks that are running, in the order of the data, and free the pipeline.
+ */
+static void pipeline_release(thermistor_handle_t* th, thermistor_pipeline_t* p)
+{
+    // No more bursts are queued or notified to the processing task after the acquisition exits.
+    if (p->acquisition_task != NULL) {
+        thermistor_task_join(th, p->acquisition_task, THERMISTOR_ACQUISITION_EXITED);
+    }
+
+    if (p->processing_task != NULL) {
+        thermistor_task_join(th, p->processing_task, THERMISTOR_PROCESSING_EXITED);
+    }
+
+    // Both tasks were deleted while not running, nothing references the pipeline.
+    th->sampling_task = NULL;
+    vEventGroupDelete(th->task_events);
+    th->task_events = NULL;
+    thermistor_free(p);
+}
+
+esp_err_t thermistor_start_pipeline(thermistor_handle_t* th, const thermistor_pipeline_config_t* config)
+{
+    if ((config->period_us < THERMISTOR_MIN_SAMPLING_PERIOD_US) ||
+        (config->batch == 0) || (config->batch > THERMISTOR_PIPELINE_MAX_BATCH) ||
+        (config->batch > (CONFIG_THERMISTOR_PIPELINE_DEPTH / 2)) ||
+        (config->acquisition_core < 0) || (config->acquisition_core >= portNUM_PROCESSORS) ||
+        (config->processing_core < 0) || (config->processing_core >= portNUM_PROCESSORS) ||
+        (config->acquisition_core == config->processing_core)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if ((th->sampling_task != NULL) || th->async_pending || th->range.enabled) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // The pipeline shares the timer of the sampling, which notifies th->sampling_task.
+    esp_err_t err = thermistor_timer_init(th);
+
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // From the arena with CONFIG_THERMISTOR_STATIC_ALLOCATION, with the stacks of both tasks.
+    thermistor_pipeline_t* p = thermistor_alloc(sizeof(thermistor_pipeline_t));
+
+    if (p == NULL) {
+        ESP_LOGE(TAG, "no memory for the pipeline");
+        return ESP_ERR_NO_MEM;
+    }
+
+    memset(p, 0, sizeof(thermistor_pipeline_t));
+    p->th = th;
+    p->config = *config;
+    thermistor_spsc_init(&p->queue, p->items, CONFIG_THERMISTOR_PIPELINE_DEPTH);
+    th->sampling_missed = 0;
+    th->task_events = xEventGroupCreateStatic(&th->task_events_buffer);
+
+    thermistor_task_storage_t* acquisition_storage = NULL;
+    thermistor_task_storage_t* processing_storage = NULL;
+
+#if CONFIG_THERMISTOR_STATIC_ALLOCATION
+    acquisition_storage = &p->acquisition_storage;
+    processing_storage = &p->processing_storage;
+#endif
+
+    err = thermistor_task_create(processing_task, "thermistor_proc", p, config->processing_core,
+                                 processing_storage, &p->processing_task);
+    if (err == ESP_OK) {
+        err = thermistor_task_create(acquisition_task, "thermistor_acq", p, config->acquisition_core,
+                                     acquisition_storage, &p->acquisition_task);
+    }
+
+    if (err == ESP_OK) {
+        th->sampling_task = p->acquisition_task;
+        err = esp_timer_start_periodic(th->sampling_timer, config->period_us);
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "pipeline not started: %s", esp_err_to_name(err));
+        pipeline_release(th, p);
+        return err;
+    }
+
+    th->sampling_period_us = config->period_us;
+    th->pipeline = p;
+
+    // The first burst is not delayed by a period.
+    xTaskNotifyGive(p->acquisition_task);
+
+    return ESP_OK;
+}
+
+esp_err_t thermistor_stop_pipeline(thermistor_handle_t* th)
+{
+    thermistor_pipeline_t* p = th->pipeline;
+
+    if (p == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Without periods the stop is the last notification of the acquisition task.
+    esp_timer_stop(th->sampling_timer);
+
+    th->pipeline = NULL;
+    pipeline_release(th, p);
+
+    return ESP_OK;
+}
+
+#else
+
+esp_err_t thermistor_start_pipeline(thermistor_handle_t* th, const thermistor_pipeline_config_t* config)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t thermistor_stop_pipeline(thermistor_handle_t* th)
+{
+    return ESP_ERR_INVALID_STATE;
+}
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_ring.c
+ * @brief Lock-free single producer, single consumer ring of samples.
+ */
+
+#include "thermistor_ring.h"
+
+#include <string.h>
+
+#define RING_MASK   (THERMISTOR_RING_SIZE - 1)
+
+void thermistor_ring_init(thermistor_ring_t* ring)
+{
+    ring->head = 0;
+    ring->tail = 0;
+    ring->dropped = 0;
+}
+
+int thermistor_ring_push(thermistor_ring_t* ring, const thermistor_sample_t* sample)
+{
+    uint32_t head = ring->head;
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    if ((head - tail) >= THERMISTOR_RING_SIZE) {
+        ring->dropped++;
+        return 0;
+    }
+
+    ring->buffer[head & RING_MASK] = *sample;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+size_t thermistor_ring_count(const thermistor_ring_t* ring)
+{
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - 
+           __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
+
+size_t thermistor_ring_peek(thermistor_ring_t* ring, const thermistor_sample_t** span)
+{
+    uint32_t tail = ring->tail;
+    uint32_t count = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - tail;
+    uint32_t index = tail & RING_MASK;
+
+    // Only up to the end of the buffer.
+    if (count > (THERMISTOR_RING_SIZE - index)) {
+        count = THERMISTOR_RING_SIZE - index;
+    }
+
+    *span = &ring->buffer[index];
+
+    return count;
+}
+
+void thermistor_ring_consume(thermistor_ring_t* ring, size_t count)
+{
+    __atomic_store_n(&ring->tail, ring->tail + count, __ATOMIC_RELEASE);
+}
+
+size_t thermistor_drain(thermistor_ring_t* ring, thermistor_sample_t* out, size_t max)
+{
+    size_t copied = 0;
+
+    // At most two spans, before and after the end of the buffer.
+    while (copied < max) {
+        const thermistor_sample_t* span;
+        size_t count = thermistor_ring_peek(ring, &span);
+
+        if (count == 0) {
+            break;
+        }
+
+        if (count > (max - copied)) {
+            count = max - copied;
+        }
+
+        memcpy(&out[copied], span, count * sizeof(thermistor_sample_t));
+        thermistor_ring_consume(ring, count);
+        copied += count;
+    }
+
+    return copied;
+}
@@ -0,0 +1,354 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_sampling.c
+ * @brief Background sampling task of thermistor component.
+ *
+ * The task is the only writer of the published readings: it fills the buffer 
+ * that is not visible and then increments the sequence, which selects the 
+ * buffer of the latest reading. A reader only retries if a new reading was 
+ * published while it was copying, so it never waits for the writer.
+ *
+ * The readings are triggered by a periodic esp_timer that notifies the task, 
+ * so the period doesn't drift with the time of the bursts. With 
+ * CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD the timer notifies the task 
+ * from its interrupt, without the latency of the esp_timer task.
+ */
+
+#include "thermistor.h"
+#include "thermistor_alloc.h"
+#include "thermistor_priv.h"
+
+#include "esp_timer.h"
+#include "esp_attr.h"
+
+#include <math.h>
+
+#include "sdkconfig.h"
+
+#include "esp_log.h"
+static const char* TAG = "drv_thr_task";
+
+void thermistor_publish(thermistor_handle_t* th, const thermistor_reading_t* reading)
+{
+    uint32_t next = th->latest_seq + 1;
+
+    th->latest[next & 1] = *reading;
+    __atomic_store_n(&th->latest_seq, next, __ATOMIC_RELEASE);
+}
+
+static void IRAM_ATTR sampling_timer_cb(void* arg)
+{
+    thermistor_handle_t* th = (thermistor_handle_t*)arg;
+
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+    BaseType_t woken = pdFALSE;
+
+    vTaskNotifyGiveFromISR(th->sampling_task, &woken);
+    if (woken == pdTRUE) {
+        esp_timer_isr_dispatch_need_yield();
+    }
+#else
+    xTaskNotifyGive(th->sampling_task);
+#endif
+}
+
+/**
+ * @brief Estimates |dT/dt| every window, and selects the period and the oversampling.
+ */
+static void adaptive_update(thermistor_handle_t* th, const thermistor_reading_t* reading)
+{
+    thermistor_adaptive_t* adaptive = &th->adaptive;
+    const thermistor_adaptive_config_t* config = &adaptive->config;
+
+    if (adaptive->anchor_us == 0) {
+        adaptive->anchor_us = reading->timestamp_us;
+        adaptive->anchor_celsius = reading->celsius;
+        return;
+    }
+
+    int64_t elapsed_us = reading->timestamp_us - adaptive->anchor_us;
+
+    if (elapsed_us < (int64_t)config->window_ms * 1000) {
+        return;
+    }
+
+    adaptive->rate = fabsf(reading->celsius - adaptive->anchor_celsius) * 1e6f / elapsed_us;
+    adaptive->anchor_us = reading->timestamp_us;
+    adaptive->anchor_celsius = reading->celsius;
+
+    uint32_t period_us = th->sampling_period_us;
+
+    if (adaptive->rate > config->threshold) {
+        adaptive->fast = true;
+        period_us = config->min_period_us;
+        th->samples = config->fast_samples;
+    } else if (adaptive->rate < (config->threshold / 2)) {
+        adaptive->fast = false;
+        period_us = (period_us > (config->max_period_us / 2)) ? config->max_period_us : (period_us * 2);
+        th->samples = config->slow_samples;
+    }
+
+    if (period_us < config->min_period_us) {
+        period_us = config->min_period_us;
+    }
+
+    if (period_us != th->sampling_period_us) {
+        esp_err_t err = esp_timer_restart(th->sampling_timer, period_us);
+
+        if (err == ESP_OK) {
+            th->sampling_period_us = period_us;
+        } else {
+            ESP_LOGW(TAG, "period not changed to %u us: %s", (unsigned)period_us, esp_err_to_name(err));
+        }
+    }
+}
+
+static void sampling_task(void* arg)
+{
+    thermistor_handle_t* th = (thermistor_handle_t*)arg;
+
+    while (1) {
+        uint32_t notified = 0;
+
+        // Each period adds one to the notification, more than one is a reading that was lost.
+        xTaskNotifyWait(0, UINT32_MAX, &notified, portMAX_DELAY);
+
+        if (notified & THERMISTOR_TASK_STOP) {
+            break;
+        }
+
+        if (notified > 1) {
+            th->sampling_missed += notified - 1;
+        }
+
+        thermistor_reading_t reading;
+
+        esp_err_t err = thermistor_acquire(th, &reading);
+
+        thermistor_publish(th, &reading);
+
+        if (th->adaptive.enabled && (err == ESP_OK)) {
+            adaptive_update(th, &reading);
+        }
+    }
+
+    // This task is the only one that restarts the timer, so no period is restarted after the stop.
+    esp_timer_stop(th->sampling_timer);
+    thermistor_task_exit(th, THERMISTOR_SAMPLING_EXITED);
+}
+
+esp_err_t thermistor_timer_init(thermistor_handle_t* th)
+{
+    // The timer is kept for the next starts, esp_timer can't be created statically.
+    if (th->sampling_timer != NULL) {
+        return ESP_OK;
+    }
+
+    esp_timer_create_args_t timer_args = {
+        .callback = sampling_timer_cb,
+        .arg = th,
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+        .dispatch_method = ESP_TIMER_ISR,
+#else
+        .dispatch_method = ESP_TIMER_TASK,
+#endif
+        .name = "thermistor",
+        .skip_unhandled_events = false,
+    };
+
+    esp_err_t err = esp_timer_create(&timer_args, &th->sampling_timer);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "sampling timer not created: %s", esp_err_to_name(err));
+        th->sampling_timer = NULL;
+    }
+
+    return err;
+}
+
+esp_err_t thermistor_task_create(TaskFunction_t function, const char* name, void* arg, BaseType_t core,
+                                 thermistor_task_storage_t* storage, TaskHandle_t* task)
+{
+#if CONFIG_THERMISTOR_STATIC_ALLOCATION
+    *task = xTaskCreateStaticPinnedToCore(function, name, CONFIG_THERMISTOR_TASK_STACK_SIZE, arg,
+                                          CONFIG_THERMISTOR_TASK_PRIORITY, storage->stack, 
+                                          &storage->tcb, core);
+#else
+    if (xTaskCreatePinnedToCore(function, name, CONFIG_THERMISTOR_TASK_STACK_SIZE, arg,
+                                CONFIG_THERMISTOR_TASK_PRIORITY, task, core) != pdPASS) {
+        *task = NULL;
+    }
+#endif
+
+    if (*task == NULL) {
+        ESP_LOGE(TAG, "no memory for the task %s", name);
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+void thermistor_task_exit(thermistor_handle_t* th, EventBits_t bit)
+{
+    xEventGroupSetBits(th->task_events, bit);
+
+    // Deleted by thermistor_task_join(), a late notification is harmless while suspended.
+    vTaskSuspend(NULL);
+}
+
+void thermistor_task_join(thermistor_handle_t* th, TaskHandle_t task, EventBits_t bit)
+{
+    xTaskNotify(task, THERMISTOR_TASK_STOP, eSetBits);
+    xEventGroupWaitBits(th->task_events, bit, pdTRUE, pdTRUE, portMAX_DELAY);
+
+    // The bit is set just before the suspension, the TCB is released only when the task is not running.
+    while (eTaskGetState(task) != eSuspended) {
+        vTaskDelay(1);
+    }
+
+    vTaskDelete(task);
+}
+
+esp_err_t thermistor_start_sampling(thermistor_handle_t* th, uint32_t period_ms)
+{
+    if (period_ms > (UINT32_MAX / 1000)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return thermistor_start_sampling_us(th, period_ms * 1000);
+}
+
+esp_err_t thermistor_start_sampling_us(thermistor_handle_t* th, uint32_t period_us)
+{
+    if (period_us < THERMISTOR_MIN_SAMPLING_PERIOD_US) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if ((th->sampling_task != NULL) || th->async_pending) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t err = thermistor_timer_init(th);
+
+    if (err != ESP_OK) {
+        return err;
+    }
+
+#if CONFIG_THERMISTOR_STATIC_ALLOCATION
+    th->sampling_storage = thermistor_alloc(sizeof(thermistor_task_storage_t));
+
+    if (th->sampling_storage == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+
+    th->sampling_period_us = period_us;
+    th->sampling_missed = 0;
+    th->adaptive.anchor_us = 0;
+    th->task_events = xEventGroupCreateStatic(&th->task_events_buffer);
+
+    err = thermistor_task_create(sampling_task, "thermistor", th, tskNO_AFFINITY, 
+                                 th->sampling_storage, &th->sampling_task);
+
+    if (err == ESP_OK) {
+        err = esp_timer_start_periodic(th->sampling_timer, period_us);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "sampling timer not started: %s", esp_err_to_name(err));
+            thermistor_task_join(th, th->sampling_task, THERMISTOR_SAMPLING_EXITED);
+        }
+    }
+
+    if (err != ESP_OK) {
+        th->sampling_task = NULL;
+        vEventGroupDelete(th->task_events);
+        th->task_events = NULL;
+        thermistor_free(th->sampling_storage);
+        th->sampling_storage = NULL;
+        return err;
+    }
+
+    // The first reading is not delayed by a period.
+    xTaskNotifyGive(th->sampling_task);
+
+    return ESP_OK;
+}
+
+esp_err_t thermistor_set_adaptive(thermistor_handle_t* th, const thermistor_adaptive_config_t* config)
+{
+    if (config == NULL) {
+        th->adaptive.enabled = false;
+        return ESP_OK;
+    }
+
+    if ((config->min_period_us < THERMISTOR_MIN_SAMPLING_PERIOD_US) ||
+        (config->max_period_us < config->min_period_us) ||
+        (config->fast_samples == 0) || (config->fast_samples > THERMISTOR_MAX_OVERSAMPLING) ||
+        (config->slow_samples == 0) || (config->slow_samples > THERMISTOR_MAX_OVERSAMPLING) ||
+        !(config->threshold > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    th->adaptive.config = *config;
+    th->adaptive.fast = false;
+    th->adaptive.anchor_us = 0;
+    th->adaptive.rate = 0;
+    th->adaptive.enabled = true;
+
+    return ESP_OK;
+}
+
+esp_err_t thermistor_stop_sampling(thermistor_handle_t* th)
+{
+    if ((th->sampling_task == NULL) || (th->pipeline != NULL)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // The task stops the timer itself after its last burst, so no adaptation restarts it later.
+    thermistor_task_join(th, th->sampling_task, THERMISTOR_SAMPLING_EXITED);
+    th->sampling_task = NULL;
+
+    // The task was deleted while not running, so its static TCB can be reused.
+    thermistor_free(th->sampling_storage);
+    th->sampling_storage = NULL;
+    vEventGroupDelete(th->task_events);
+    th->task_events = NULL;
+
+    return ESP_OK;
+}
+
+esp_err_t thermistor_get_latest(const thermistor_handle_t* th, thermistor_reading_t* reading)
+{
+    uint32_t seq;
+    
+    do {
+        seq = __atomic_load_n(&th->latest_seq, __ATOMIC_ACQUIRE);
+        *reading = th->latest[seq & 1];
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        // A new publication may be overwriting this buffer, copy it again.
+    } while (__atomic_load_n(&th->latest_seq, __ATOMIC_RELAXED) != seq);
+
+    return (seq == 0) ? ESP_ERR_INVALID_STATE : ESP_OK;
+}
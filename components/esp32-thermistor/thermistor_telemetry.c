@@ -0,0 +1,274 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_telemetry.c
+ * @brief Encoder and decoder of the binary telemetry records.
+ */
+
+#include "thermistor_telemetry.h"
+
+#define HEADER_KEY      0x80
+#define SEQ_MASK        0x7F
+#define KEY_SIZE        7
+#define DELTA_MIN_SIZE  4
+#define FRAME_OVERHEAD  2       // COBS code byte and delimiter, records are shorter than 254 bytes.
+
+static void put_u16(uint8_t* buf, uint16_t value)
+{
+    buf[0] = value & 0xFF;
+    buf[1] = value >> 8;
+}
+
+static uint16_t get_u16(const uint8_t* buf)
+{
+    return buf[0] | (buf[1] << 8);
+}
+
+/**
+ * @brief Encode a record with COBS, so the frame has no zero bytes.
+ *
+ * @return
+ *      - Size of the encoded record, without the delimiter.
+ */
+static size_t cobs_encode(const uint8_t* in, size_t len, uint8_t* out)
+{
+    size_t code_index = 0;
+    size_t size = 1;
+    uint8_t code = 1;
+
+    for (size_t i = 0; i < len; i++) {
+        if (in[i] == 0) {
+            out[code_index] = code;
+            code_index = size++;
+            code = 1;
+        } else {
+            out[size++] = in[i];
+            code++;
+        }
+    }
+
+    out[code_index] = code;
+
+    return size;
+}
+
+/**
+ * @brief Decode a COBS frame, without its delimiter.
+ *
+ * @return
+ *      - Size of the record, or 0 if the frame is not valid or longer than max.
+ */
+static size_t cobs_decode(const uint8_t* in, size_t len, uint8_t* out, size_t max)
+{
+    size_t i = 0;
+    size_t size = 0;
+
+    while (i < len) {
+        uint8_t code = in[i++];
+
+        if ((code == 0) || ((i + code - 1) > len) || ((size + code - 1) > max)) {
+            return 0;
+        }
+
+        for (uint8_t k = 1; k < code; k++) {
+            out[size++] = in[i++];
+        }
+
+        if ((code < 0xFF) && (i < len)) {
+            if (size >= max) {
+                return 0;
+            }
+            out[size++] = 0;
+        }
+    }
+
+    return size;
+}
+
+void thermistor_telemetry_encoder_init(thermistor_telemetry_encoder_t* enc, uint16_t key_interval)
+{
+    enc->seq = 0;
+    enc->key_interval = key_interval;
+    enc->since_key = key_interval;      // Start with a key record.
+    enc->last_centi = 0;
+}
+
+size_t thermistor_telemetry_encode(thermistor_telemetry_encoder_t* enc, uint16_t raw, 
+                                   int16_t centi_celsius, uint8_t* buf, size_t len)
+{
+    uint8_t record[KEY_SIZE];
+    size_t size;
+    bool key = (enc->since_key >= enc->key_interval);
+
+    if (key) {
+        record[0] = HEADER_KEY | (enc->seq & SEQ_MASK);
+        put_u16(&record[1], enc->seq);
+        put_u16(&record[3], raw);
+        put_u16(&record[5], (uint16_t)centi_celsius);
+        size = KEY_SIZE;
+    } else {
+        // Zigzag keeps the small negative differences in one byte.
+        int32_t delta = (int32_t)centi_celsius - enc->last_centi;
+        uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+
+        record[0] = enc->seq & SEQ_MASK;
+        put_u16(&record[1], raw);
+        size = 3;
+
+        do {
+            record[size] = zigzag & 0x7F;
+            zigzag >>= 7;
+            if (zigzag != 0) {
+                record[size] |= 0x80;
+            }
+            size++;
+        } while (zigzag != 0);
+    }
+
+    if (len < (size + FRAME_OVERHEAD)) {
+        return 0;
+    }
+
+    size = cobs_encode(record, size, buf);
+    buf[size++] = 0;
+
+    enc->since_key = key ? 1 : (enc->since_key + 1);
+    enc->seq++;
+    enc->last_centi = centi_celsius;
+
+    return size;
+}
+
+void thermistor_telemetry_decoder_init(thermistor_telemetry_decoder_t* dec)
+{
+    dec->synced = false;
+    dec->seq = 0;
+    dec->last_centi = 0;
+    dec->lost = 0;
+}
+
+/**
+ * @brief Decode a record extracted from its frame.
+ *
+ * @return
+ *      - true: out is valid.
+ */
+static bool decode_record(thermistor_telemetry_decoder_t* dec, const uint8_t* record, 
+                          size_t len, thermistor_telemetry_record_t* out)
+{
+    if (record[0] & HEADER_KEY) {
+        if (len != KEY_SIZE) {
+            return false;
+        }
+
+        uint16_t seq = get_u16(&record[1]);
+
+        if (dec->synced && (seq != (uint16_t)(dec->seq + 1))) {
+            dec->lost += (uint16_t)(seq - dec->seq - 1);
+        }
+
+        dec->synced = true;
+        dec->seq = seq;
+        dec->last_centi = (int16_t)get_u16(&record[5]);
+        
+        out->seq = seq;
+        out->raw = get_u16(&record[3]);
+        out->centi_celsius = dec->last_centi;
+
+        return true;
+    }
+
+    if (len < DELTA_MIN_SIZE) {
+        return false;
+    }
+
+    uint32_t zigzag = 0;
+    size_t size = 3;
+    
+    for (uint8_t shift = 0; ; shift += 7) {
+        if (size >= len) {
+            return false;
+        }
+
+        uint8_t byte = record[size++];
+        
+        zigzag |= (uint32_t)(byte & 0x7F) << shift;
+        if (((byte & 0x80) == 0) || (shift >= 14)) {
+            break;
+        }
+    }
+
+    if (size != len) {
+        return false;
+    }
+
+    uint16_t seq = dec->seq + 1;
+
+    if (dec->synced && ((record[0] & SEQ_MASK) != (seq & SEQ_MASK))) {
+        // The base of the difference was lost, wait for the next key record.
+        dec->lost += ((record[0] - seq) & SEQ_MASK);
+        dec->synced = false;
+    }
+
+    if (!dec->synced) {
+        return false;
+    }
+
+    int32_t delta = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+    
+    dec->seq = seq;
+    dec->last_centi = (int16_t)(dec->last_centi + delta);
+    
+    out->seq = seq;
+    out->raw = get_u16(&record[1]);
+    out->centi_celsius = dec->last_centi;
+
+    return true;
+}
+
+int thermistor_telemetry_decode(thermistor_telemetry_decoder_t* dec, const uint8_t* buf, 
+                                size_t len, thermistor_telemetry_record_t* out)
+{
+    size_t end = 0;
+
+    while ((end < len) && (buf[end] != 0)) {
+        end++;
+    }
+
+    if (end == len) {
+        // Without a delimiter in the length of a frame, the bytes are noise.
+        return (len < THERMISTOR_TELEMETRY_MAX_RECORD) ? 0 : -(int)len;
+    }
+
+    uint8_t record[KEY_SIZE];
+    size_t size = cobs_decode(buf, end, record, sizeof(record));
+    int frame = (int)end + 1;
+
+    if ((size == 0) || !decode_record(dec, record, size, out)) {
+        return -frame;
+    }
+
+    return frame;
+}
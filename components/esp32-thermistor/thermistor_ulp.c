@@ -0,0 +1,204 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2021 Juan Schiavoni
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file thermistor_ulp.c
+ * @brief ULP program that samples the thermistor during the deep sleep.
+ */
+
+#include "thermistor_ulp.h"
+#include "thermistor_adc.h"
+
+#if CONFIG_ULP_COPROC_TYPE_FSM && CONFIG_IDF_TARGET_ESP32
+
+#include "esp32/ulp.h"
+#include "ulp_adc.h"
+#include "esp_sleep.h"
+#include "soc/rtc_cntl_reg.h"
+
+#include "esp_log.h"
+static const char* TAG = "drv_thr_ulp";
+
+#ifndef CONFIG_THERMISTOR_ULP_OVERSAMPLING_SHIFT
+#define CONFIG_THERMISTOR_ULP_OVERSAMPLING_SHIFT 3
+#endif
+
+// The registers of the ULP have 16 bits, so a burst of 12 bits codes is up to 16 samples.
+#define ULP_SAMPLES     (1 << CONFIG_THERMISTOR_ULP_OVERSAMPLING_SHIFT)
+
+// Data words at the end of the reserved memory, after the program.
+#define DATA_COUNT      0
+#define DATA_BUFFER     1
+#define DATA_WORDS      (DATA_BUFFER + THERMISTOR_ULP_MAX_BATCH)
+#define DATA_ADDR       ((CONFIG_ULP_COPROC_RESERVE_MEM / sizeof(uint32_t)) - DATA_WORDS)
+
+enum {
+    LABEL_SAMPLE,
+    LABEL_WAKE,
+    LABEL_EXIT,
+};
+
+esp_err_t thermistor_ulp_start(thermistor_handle_t* th, const thermistor_ulp_config_t* config)
+{
+    int raw_hot;
+    int raw_cold;
+
+    if ((config->batch == 0) || (config->batch > THERMISTOR_ULP_MAX_BATCH) || 
+        (config->period_ms == 0) || !(config->low_celsius < config->high_celsius)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // The program reads the channel at 12 dB, the thresholds of other ranges do not apply.
+    if ((th->sampling_task != NULL) || th->async_pending || th->range.enabled) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (!thermistor_adc_is_exclusive(th->channel)) {
+        ESP_LOGE(TAG, "ADC1 is in use by other thermistors");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // A hotter thermistor has a lower resistance, and reads a lower raw code.
+    if ((thermistor_celsius_to_raw(th, config->high_celsius, &raw_hot) != ESP_OK) ||
+        (thermistor_celsius_to_raw(th, config->low_celsius, &raw_cold) != ESP_OK)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    const ulp_insn_t program[] = {
+        I_MOVI(R3, DATA_ADDR),
+        I_LD(R2, R3, DATA_COUNT),                       // R2: stored samples.
+        I_MOVR(R0, R2),
+        M_BGE(LABEL_WAKE, config->batch),               // Full, only retry the wake up.
+        I_MOVI(R1, 0),
+        I_MOVI(R2, 0),
+        M_LABEL(LABEL_SAMPLE),
+        I_ADC(R0, 0, th->channel),
+        I_ADDR(R1, R1, R0),
+        I_ADDI(R2, R2, 1),
+        I_MOVR(R0, R2),
+        M_BL(LABEL_SAMPLE, ULP_SAMPLES),
+        I_RSHI(R1, R1, CONFIG_THERMISTOR_ULP_OVERSAMPLING_SHIFT), // R1: averaged raw code.
+        I_LD(R2, R3, DATA_COUNT),
+        I_ADDR(R0, R3, R2),
+        I_ST(R1, R0, DATA_BUFFER),
+        I_ADDI(R2, R2, 1),
+        I_ST(R2, R3, DATA_COUNT),
+        I_MOVR(R0, R1),
+        M_BL(LABEL_WAKE, raw_hot),                      // Hotter than high_celsius.
+        M_BGE(LABEL_WAKE, raw_cold + 1),                // Colder than low_celsius.
+        I_MOVR(R0, R2),
+        M_BGE(LABEL_WAKE, config->batch),
+        I_HALT(),
+        M_LABEL(LABEL_WAKE),
+        I_RD_REG(RTC_CNTL_LOW_POWER_ST_REG, RTC_CNTL_RDY_FOR_WAKEUP_S, RTC_CNTL_RDY_FOR_WAKEUP_S),
+        M_BL(LABEL_EXIT, 1),                            // Not ready, retry in the next period.
+        I_WAKE(),
+        I_WR_REG_BIT(RTC_CNTL_STATE0_REG, RTC_CNTL_ULP_CP_SLP_TIMER_EN_S, 0),
+        M_LABEL(LABEL_EXIT),
+        I_HALT(),
+    };
+
+    size_t size = sizeof(program) / sizeof(ulp_insn_t);
+    esp_err_t err = ulp_process_macros_and_load(0, program, &size);
+
+    if ((err != ESP_OK) || (size > DATA_ADDR)) {
+        ESP_LOGE(TAG, "the program and %d samples don't fit in the ULP memory", 
+                 THERMISTOR_ULP_MAX_BATCH);
+        return ESP_ERR_NO_MEM;
+    }
+
+    RTC_SLOW_MEM[DATA_ADDR + DATA_COUNT] = 0;
+
+    ulp_set_wakeup_period(0, config->period_ms * 1000);
+
+    err = esp_sleep_enable_ulp_wakeup();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // The ULP needs the ADC1 for itself, the only channel is released to it.
+    thermistor_adc_remove_channel(th->channel);
+    th->adc_h = NULL;
+
+    ulp_adc_cfg_t adc_config = {
+        .adc_n = ADC_UNIT_1,
+        .channel = th->channel,
+        .atten = ADC_ATTEN_DB_12,
+        .width = ADC_BITWIDTH_12,
+        .ulp_mode = ADC_ULP_MODE_FSM,
+    };
+
+    err = ulp_adc_init(&adc_config);
+    if (err == ESP_OK) {
+        err = ulp_run(0);
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "ULP not started: %s", esp_err_to_name(err));
+
+        // Give the channel back, so the handle can still be read.
+        if (thermistor_adc_add_channel(th->channel, ADC_ATTEN_DB_12, 
+                                       &th->adc_h, &th->adc_cont_h) != ESP_OK) {
+            ESP_LOGE(TAG, "channel %d not registered again", th->channel);
+        }
+    }
+
+    return err;
+}
+
+size_t thermistor_ulp_get_samples(uint16_t* raw, size_t max)
+{
+    // The ULP stores its PC in the upper half of each word.
+    size_t count = RTC_SLOW_MEM[DATA_ADDR + DATA_COUNT] & UINT16_MAX;
+
+    if (count > THERMISTOR_ULP_MAX_BATCH) {
+        count = 0;      // Not written by the program (power on reset).
+    }
+
+    if (count > max) {
+        count = max;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        raw[i] = RTC_SLOW_MEM[DATA_ADDR + DATA_BUFFER + i] & UINT16_MAX;
+    }
+
+    RTC_SLOW_MEM[DATA_ADDR + DATA_COUNT] = 0;
+
+    return count;
+}
+
+#else
+
+esp_err_t thermistor_ulp_start(thermistor_handle_t* th, const thermistor_ulp_config_t* config)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+size_t thermistor_ulp_get_samples(uint16_t* raw, size_t max)
+{
+    return 0;
+}
+
+#endif /* CONFIG_ULP_COPROC_TYPE_FSM */
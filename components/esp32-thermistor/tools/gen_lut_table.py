@@ -0,0 +1,78 @@
+#!/usr/bin/env python
+#
+# MIT License
+#
+# Copyright (c) 2021 Juan Schiavoni
+#
+# Generates the header with the lookup table of the thermistor, so it is 
+# placed in flash (rodata) instead of being built in RAM by thermistor_init().
+# The entries are calculated exactly as lut_entry() in thermistor.c.
+
+import argparse
+import math
+import os
+
+INT16_MAX = 32767
+INT16_MIN = -32768
+
+
+def lut_entry(args, vout):
+    if vout == 0:
+        return INT16_MAX    # Shorted thermistor, hotter than the range of the table.
+
+    if vout >= args.vsource:
+        return INT16_MIN    # Open thermistor, colder than the range of the table.
+
+    resistance = (args.serial_resistance * vout) / (args.vsource - vout)
+    steinhart = math.log(resistance / args.nominal_resistance) / args.beta
+    steinhart += 1.0 / (args.nominal_temperature + 273.15)
+    centi = ((1.0 / steinhart) - 273.15) * 100.0
+
+    # Below absolute zero the equation is outside its domain (R close to 0).
+    if centi < -27315.0 or centi > INT16_MAX:
+        return INT16_MAX
+
+    if centi < INT16_MIN:
+        return INT16_MIN
+
+    return int(math.floor(centi + 0.5)) if centi >= 0 else -int(math.floor(-centi + 0.5))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Generate the thermistor lookup table')
+    parser.add_argument('--serial-resistance', type=float, required=True)
+    parser.add_argument('--nominal-resistance', type=float, required=True)
+    parser.add_argument('--nominal-temperature', type=float, required=True)
+    parser.add_argument('--beta', type=float, required=True)
+    parser.add_argument('--vsource', type=float, required=True)
+    parser.add_argument('--shift', type=int, required=True)
+    parser.add_argument('--output', required=True)
+    args = parser.parse_args()
+
+    size = (int(args.vsource) >> args.shift) + 2
+    entries = [lut_entry(args, i << args.shift) for i in range(size)]
+
+    lines = [
+        '/* Generated by gen_lut_table.py from the sdkconfig values, do not edit. */',
+        '',
+        '#define THERMISTOR_LUT_ROM_SHIFT    {}'.format(args.shift),
+        '',
+        'static const int16_t thermistor_lut_rom[{}] = {{'.format(size),
+    ]
+    for i in range(0, size, 10):
+        lines.append('    ' + ', '.join('{:6d}'.format(e) for e in entries[i:i + 10]) + ',')
+    lines.append('};')
+    content = '\n'.join(lines) + '\n'
+
+    # Only touch the output when it changes, to avoid rebuilding the component.
+    if os.path.exists(args.output):
+        with open(args.output) as f:
+            if f.read() == content:
+                return
+
+    with open(args.output, 'w') as f:
+        f.write(content)
+
+
+if __name__ == '__main__':
+    main()
@@ -31,12 +31,18 @@
  * Each 200 ms is invoked the function that reads the voltage of the resistive 
  * divider and converts it to degrees Celsius using the simplified equation 
  * of Steniarth.
- * The temperature is shown on the monitor in degrees Celsius and Fahrenheit.
+ * The temperature is shown on the monitor in degrees Celsius and Fahrenheit,
+ * or streamed as binary telemetry records on a UART apart from the console 
+ * when EXAMPLE_TELEMETRY_BINARY is set.
  */
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "driver/gpio.h"
+#include "driver/uart.h"
 #include "thermistor.h"
+#include "thermistor_telemetry.h"
+#include "nvs_flash.h"
+#include <math.h>
 
 #include "sdkconfig.h"
 
@@ -86,6 +92,16 @@ static void temperature_to_light(float celsius)
 void app_main(void)
 {
     thermistor_handle_t th = {0};
+
+#if CONFIG_THERMISTOR_NVS_CACHE
+    esp_err_t err = nvs_flash_init();
+    if ((err == ESP_ERR_NVS_NO_FREE_PAGES) || (err == ESP_ERR_NVS_NEW_VERSION_FOUND)) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        err = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(err);
+#endif
+
     ESP_ERROR_CHECK(thermistor_init(&th, ADC_CHANNEL_2, 
                                     CONFIG_SERIE_RESISTANCE, 
                                     CONFIG_NOMINAL_RESISTANCE, 
@@ -93,10 +109,69 @@ void app_main(void)
                                     CONFIG_BETA_VALUE, 
                                     CONFIG_VOLTAGE_SOURCE));
 
+#if CONFIG_THERMISTOR_NVS_CACHE
+    // First boot (or new parameters), store the calibration for the next ones.
+    if (th.cali_table == NULL) {
+        thermistor_save_calibration(&th);
+    }
+#endif
+
     init_led();
  
+#ifdef CONFIG_EXAMPLE_TELEMETRY_BINARY
+    // The frames go to their own UART, the log output would corrupt them on the console.
+    uart_config_t uart_config = {
+        .baud_rate = CONFIG_EXAMPLE_TELEMETRY_UART_BAUD,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_DEFAULT,
+    };
+
+    ESP_ERROR_CHECK(uart_driver_install(CONFIG_EXAMPLE_TELEMETRY_UART_NUM, 256, 0, 0, NULL, 0));
+    ESP_ERROR_CHECK(uart_param_config(CONFIG_EXAMPLE_TELEMETRY_UART_NUM, &uart_config));
+    ESP_ERROR_CHECK(uart_set_pin(CONFIG_EXAMPLE_TELEMETRY_UART_NUM, CONFIG_EXAMPLE_TELEMETRY_UART_TX_GPIO,
+                                 UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+
+    thermistor_telemetry_encoder_t enc;
+    thermistor_telemetry_encoder_init(&enc, CONFIG_EXAMPLE_TELEMETRY_KEY_INTERVAL);
+    ESP_ERROR_CHECK(thermistor_start_sampling(&th, 200));
+#endif
+ 
     while(1) {
+#ifdef CONFIG_EXAMPLE_TELEMETRY_BINARY
+        thermistor_reading_t reading;
+        uint8_t record[THERMISTOR_TELEMETRY_MAX_RECORD];
+
+        vTaskDelay(200 / portTICK_PERIOD_MS);
+        if (thermistor_get_latest(&th, &reading) != ESP_OK) {
+            continue;
+        }
+
+        // A faulted reading has no temperature (NAN), it is not streamed.
+        if (reading.fault != THERMISTOR_FAULT_NONE) {
+            continue;
+        }
+
+        // Saturated as the samples of the ring, out of range values can't overflow the int16.
+        float centi = reading.celsius * 100.0f;
+        int16_t centi_celsius = (centi >= INT16_MAX) ? INT16_MAX : 
+                                !(centi > INT16_MIN) ? INT16_MIN : (int16_t)lroundf(centi);
+        size_t len = thermistor_telemetry_encode(&enc, reading.raw, centi_celsius, 
+                                                 record, sizeof(record));
+
+        uart_write_bytes(CONFIG_EXAMPLE_TELEMETRY_UART_NUM, record, len);
+        temperature_to_light(reading.celsius);
+#else
         float celsius = thermistor_get_celsius(&th);
+
+        if (th.fault != THERMISTOR_FAULT_NONE) {
+            ESP_LOGW(TAG, "Thermistor %s", (th.fault == THERMISTOR_FAULT_OPEN) ? "open" : "shorted");
+            vTaskDelay(200 / portTICK_PERIOD_MS);
+            continue;
+        }
+
         float fahrenheit = thermistor_celsius_to_fahrenheit(celsius);
 
         ESP_LOGI(TAG,"Voltage: %d mV\tTemperature: %2.1f C / %2.1f F:\tResistance: %.0f ohm", 
@@ -104,5 +179,6 @@ void app_main(void)
 
         temperature_to_light(celsius);
         vTaskDelay(200 / portTICK_PERIOD_MS);
+#endif
     }
 }